@@ -0,0 +1,107 @@
+#ifndef BLOCKEDBLOOMFILTER_HPP
+#define BLOCKEDBLOOMFILTER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+/*
+ * Bloom filter over 64-bit items where all probes of an item fall into one
+ * 512-bit block (a cache line), so a lookup costs a single cache miss.
+ * At 8 bits per item and 6 probes the false positive rate is about 3%.
+ */
+class BlockedBloomFilter{
+	static constexpr size_t blockWords = 8;
+	static constexpr size_t blockBits = blockWords * 64;
+
+	std::vector<uint64_t> storage;
+	uint64_t *blocks = nullptr; // first cache line aligned word of storage
+	size_t blockCount;
+	size_t hashCount;
+
+	static uint64_t mix(uint64_t item){
+		item ^= item >> 33;
+		item *= 0xff51afd7ed558ccdULL;
+		item ^= item >> 33;
+		item *= 0xc4ceb9fe1a85ec53ULL;
+		item ^= item >> 33;
+
+		return item;
+	}
+
+	uint64_t *block(const uint64_t hash) const{
+		const size_t index = static_cast<size_t>(((hash >> 32) * this->blockCount) >> 32);
+		return this->blocks + index * blockWords;
+	}
+
+public:
+	BlockedBloomFilter(const size_t expectedItems, const size_t bitsPerItem = 8, const size_t hashCount = 6):
+		hashCount(hashCount)
+	{
+		if(hashCount == 0 || hashCount > 7){
+			throw std::invalid_argument("hashCount must be within 1..7");
+		}
+
+		this->blockCount = (expectedItems * bitsPerItem + blockBits - 1) / blockBits;
+		if(this->blockCount == 0){
+			this->blockCount = 1;
+		}
+
+		if(this->blockCount > UINT32_MAX){
+			throw std::length_error("BlockedBloomFilter is too large");
+		}
+
+		this->storage.assign(this->blockCount * blockWords + blockWords - 1, 0);
+
+		const uintptr_t address = reinterpret_cast<uintptr_t>(this->storage.data());
+		this->blocks = this->storage.data() + ((64 - address % 64) % 64) / sizeof(uint64_t);
+	}
+
+	BlockedBloomFilter(const BlockedBloomFilter &) = delete;
+	BlockedBloomFilter &operator=(const BlockedBloomFilter &) = delete;
+
+	bool contains(const uint64_t item) const{
+		const uint64_t hash = BlockedBloomFilter::mix(item);
+		const uint64_t probes = BlockedBloomFilter::mix(hash);
+		const uint64_t *block = this->block(hash);
+
+		for(size_t i = 0; i < this->hashCount; ++i){
+			const size_t bit = (probes >> (9 * i)) & (blockBits - 1);
+
+			if((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0){
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// adds the item, returns true if it was (possibly falsely) contained before
+	bool testAndSet(const uint64_t item){
+		const uint64_t hash = BlockedBloomFilter::mix(item);
+		const uint64_t probes = BlockedBloomFilter::mix(hash);
+		uint64_t *block = this->block(hash);
+
+		bool contained = true;
+		for(size_t i = 0; i < this->hashCount; ++i){
+			const size_t bit = (probes >> (9 * i)) & (blockBits - 1);
+			const uint64_t mask = uint64_t(1) << (bit % 64);
+
+			contained = contained && (block[bit / 64] & mask) != 0;
+			block[bit / 64] |= mask;
+		}
+
+		return contained;
+	}
+
+	void clear(){
+		this->storage.assign(this->storage.size(), 0);
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return this->storage.size() * sizeof(uint64_t);
+	}
+};
+
+#endif // BLOCKEDBLOOMFILTER_HPP
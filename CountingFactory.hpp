@@ -1,14 +1,25 @@
 #ifndef COUNTINGFACTORY_HPP
 #define COUNTINGFACTORY_HPP
 
+#include <atomic>
 #include <cstddef>
+#include <cassert>
 #include <utility>
 
 template<typename Product>
 class CountingFactory{
-	mutable size_t objectCount = 0;
+	mutable std::atomic<size_t> objectCount; // products of different heads may be created concurrently
 
 public:
+	CountingFactory(): objectCount(0){}
+
+	CountingFactory(const CountingFactory &o): objectCount(o.objectCount.load()){}
+
+	CountingFactory &operator=(const CountingFactory &o){
+		this->objectCount = o.objectCount.load();
+		return *this;
+	}
+
 	template<typename...  ConstructorArgs>
 	Product *create(ConstructorArgs... args) const{
 		Product *product = new Product(std::forward<ConstructorArgs>(args)...);
@@ -18,6 +29,17 @@ public:
 		return product;
 	}
 
+	// accounts for `count` products destroyed outside of reset()
+	void release(const size_t count) const{
+		assert(count <= this->objectCount);
+		this->objectCount -= count;
+	}
+
+	// accounts for `count` products handed over by another factory
+	void adopt(const size_t count) const{
+		this->objectCount += count;
+	}
+
 	size_t producedItemsCount() const{
 		return this->objectCount;
 	}
@@ -0,0 +1,388 @@
+#ifndef FIXEDHYBRIDLARGEDATASTORAGE_HPP
+#define FIXEDHYBRIDLARGEDATASTORAGE_HPP
+
+#include "IndexedNodePool.hpp"
+
+#include <array>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cassert>
+#include <limits>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore>
+class FixedHybridLargeDataStorage;
+
+namespace FixedHLDS{
+	constexpr size_t power(const size_t base, const size_t exponent){
+		return exponent == 0 ? 1 : base * power(base, exponent - 1);
+	}
+
+	// base^exponent - 1 fits size_t
+	constexpr bool powerFits(const size_t base, const size_t exponent, const size_t value = 1){
+		return exponent == 0 || (value <= std::numeric_limits<size_t>::max() / base && powerFits(base, exponent - 1, value * base));
+	}
+}
+
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore = PlainValueStore<Value>>
+class FixedIterator{
+	typedef FixedHybridLargeDataStorage<Key, Value, keyLength, headLength, ValueStore> Storage;
+	typedef typename Storage::Pool Pool;
+	typedef typename Pool::Handle Handle;
+
+	static constexpr size_t tailLength = keyLength - headLength;
+
+	Storage *storage = nullptr;
+	size_t head = Storage::headCount; // headCount marks the end
+	std::array<Handle, tailLength> branch;	// node on every tail level
+	std::array<uint8_t, tailLength> symbols;	// symbol taken on every tail level
+
+	// descends from `level` along the lowest existing symbols
+	void descendFirst(size_t level){
+		for(; level < tailLength; ++level){
+			const typename Pool::Node &node = this->storage->pool.node(this->branch[level]);
+
+			uint8_t symbol = 0;
+			while(node[symbol] == Pool::null){
+				++symbol;
+			}
+
+			this->symbols[level] = symbol;
+			if(level + 1 < tailLength){
+				this->branch[level + 1] = node[symbol];
+			}
+		}
+	}
+
+	void seekHead(size_t head){
+		while(head < Storage::headCount && this->storage->heads[head] == Pool::null){
+			++head;
+		}
+
+		this->head = head;
+		if(head < Storage::headCount){
+			this->branch[0] = this->storage->heads[head];
+			this->descendFirst(0);
+		}
+	}
+
+public:
+	typedef size_t						difference_type;
+	typedef Value						value_type;
+	typedef Value *						pointer;
+	typedef Value &						reference;
+	typedef std::forward_iterator_tag	iterator_category;
+
+	FixedIterator(){}
+
+	// first key at or after the head
+	FixedIterator(Storage *storage, const size_t head): storage(storage){
+		this->seekHead(head);
+	}
+
+	FixedIterator(Storage *storage, const size_t head, const std::array<Handle, tailLength> &branch, const std::array<uint8_t, tailLength> &symbols):
+		storage(storage),
+		head(head),
+		branch(branch),
+		symbols(symbols)
+	{
+
+	}
+
+	bool operator==(const FixedIterator &o) const{
+		if(this->head == Storage::headCount || o.head == Storage::headCount){
+			return this->head == o.head;
+		}
+
+		return this->head == o.head && this->symbols == o.symbols;
+	}
+
+	bool operator!=(const FixedIterator &o) const{
+		return !(*this == o);
+	}
+
+	typename Pool::ValueReference operator*() const{
+		const Handle leaf = this->storage->pool.node(this->branch[tailLength - 1])[this->symbols[tailLength - 1]];
+		return this->storage->pool.value(leaf);
+	}
+
+	Key getKey() const{
+		Key key(keyLength);
+
+		size_t head = this->head;
+		for(size_t i = headLength; i-- > 0;){
+			key[i] = Key::value_type::fromIndex(head % Key::value_type::alphabetSize);
+			head /= Key::value_type::alphabetSize;
+		}
+
+		for(size_t i = 0; i < tailLength; ++i){
+			key[headLength + i] = Key::value_type::fromIndex(this->symbols[i]);
+		}
+
+		return key;
+	}
+
+	FixedIterator &operator++(){
+		const Pool &pool = this->storage->pool;
+
+		for(size_t level = tailLength; level-- > 0;){
+			const typename Pool::Node &node = pool.node(this->branch[level]);
+
+			for(size_t symbol = this->symbols[level] + 1; symbol < node.size(); ++symbol){
+				if(node[symbol] != Pool::null){
+					this->symbols[level] = static_cast<uint8_t>(symbol);
+					if(level + 1 < tailLength){
+						this->branch[level + 1] = node[symbol];
+						this->descendFirst(level + 1);
+					}
+
+					return *this;
+				}
+			}
+		}
+
+		this->seekHead(this->head + 1);
+		return *this;
+	}
+};
+
+/*
+ * IndexedHybridLargeDataStorage with the key and head lengths fixed at compile time:
+ * the head count is a constant, the tail descent is unrolled level by level
+ * (divisions of accumulateIndex() become multiplications by constants) and
+ * iterators keep their branch in std::array.
+ *
+ * ValueStore selects the value storage, e.g. NarrowCounterStore for counts.
+ *
+ * Typical configurations are FixedHybridLargeDataStorage<Key, Value, 21, 8>,
+ * <Key, Value, 25, 10> and <Key, Value, 31, 11>.
+ */
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore = PlainValueStore<Value>>
+class FixedHybridLargeDataStorage{
+	static_assert(headLength < keyLength, "the tail must not be empty");
+
+	static constexpr size_t alphabetSize = Key::value_type::alphabetSize;
+
+public:
+	static constexpr size_t tailLength = keyLength - headLength;
+	static constexpr size_t headCount = FixedHLDS::power(alphabetSize, headLength);
+
+	typedef FixedIterator<Key, Value, keyLength, headLength, ValueStore> iterator;
+
+private:
+	typedef IndexedNodePool<Value, alphabetSize, ValueStore> Pool;
+	typedef typename Pool::Handle Handle;
+
+	template<size_t level>
+	using Level = std::integral_constant<size_t, level>;
+
+	size_t id;
+	size_t itemCount = 0;
+
+	std::vector<Handle> heads;
+	Pool pool;
+
+	static size_t generateRandomId(){
+		static std::default_random_engine re(std::chrono::system_clock::now().time_since_epoch().count());
+		static std::uniform_int_distribution<size_t> distr;
+
+		return distr(re);
+	}
+
+	static size_t headIndex(const Key &key){
+		size_t result = 0;
+		for(size_t i = 0; i < headLength; ++i){
+			result = result * alphabetSize + key[i].toIndex();
+		}
+
+		return result;
+	}
+
+	// handle slot of the key's value, creating the missing inner nodes
+	template<size_t level>
+	Handle &descend(Handle &slot, const Key &key, Level<level>){
+		if(slot == Pool::null){
+			slot = this->pool.createNode();
+		}
+
+		Handle &child = this->pool.node(slot)[key[headLength + level].toIndex()];
+		return this->descend(child, key, Level<level + 1>());
+	}
+
+	Handle &descend(Handle &slot, const Key &, Level<tailLength>){
+		return slot;
+	}
+
+	// same as descend() for the tail given by its Key::toIndex()
+	template<size_t level>
+	Handle &descendIndex(Handle &slot, const size_t tailIndex, Level<level>){
+		if(slot == Pool::null){
+			slot = this->pool.createNode();
+		}
+
+		constexpr size_t divisor = FixedHLDS::power(alphabetSize, tailLength - level - 1);
+
+		Handle &child = this->pool.node(slot)[tailIndex / divisor % alphabetSize];
+		return this->descendIndex(child, tailIndex, Level<level + 1>());
+	}
+
+	Handle &descendIndex(Handle &slot, const size_t, Level<tailLength>){
+		return slot;
+	}
+
+	template<size_t level>
+	Handle findIndex(const Handle node, const size_t tailIndex, Level<level>) const{
+		if(node == Pool::null){
+			return Pool::null;
+		}
+
+		constexpr size_t divisor = FixedHLDS::power(alphabetSize, tailLength - level - 1);
+
+		const Handle child = this->pool.node(node)[tailIndex / divisor % alphabetSize];
+		return this->findIndex(child, tailIndex, Level<level + 1>());
+	}
+
+	Handle findIndex(const Handle node, const size_t, Level<tailLength>) const{
+		return node;
+	}
+
+	void addNew(Handle &leaf, const Value &value){
+		leaf = this->pool.createValue(value);
+		++this->itemCount;
+	}
+
+public:
+	FixedHybridLargeDataStorage(const size_t id): id(id), heads(headCount, Pool::null){}
+
+	FixedHybridLargeDataStorage(): FixedHybridLargeDataStorage(FixedHybridLargeDataStorage::generateRandomId()){}
+
+	void clear(){
+		this->itemCount = 0;
+		this->heads.assign(headCount, Pool::null);
+		this->pool.clear();
+	}
+
+	static constexpr size_t keySize(){
+		return keyLength;
+	}
+
+	static constexpr size_t getHeadSize(){
+		return headLength;
+	}
+
+	size_t getId() const{
+		return this->id;
+	}
+
+	size_t size() const{
+		return this->itemCount;
+	}
+
+	void insert(const Key &key, const Value &value){
+		assert(key.size() == keyLength);
+
+		Handle &leaf = this->descend(this->heads[FixedHybridLargeDataStorage::headIndex(key)], key, Level<0>());
+		if(leaf != Pool::null){
+			throw std::runtime_error("Node with this key already exists");
+		}
+
+		this->addNew(leaf, value);
+	}
+
+	// inserts the key or adds value to the stored one
+	void accumulate(const Key &key, const Value &value){
+		assert(key.size() == keyLength);
+
+		Handle &leaf = this->descend(this->heads[FixedHybridLargeDataStorage::headIndex(key)], key, Level<0>());
+		if(leaf == Pool::null){
+			this->addNew(leaf, value);
+		}
+		else{
+			this->pool.value(leaf) += value;
+		}
+	}
+
+	// accumulate() for the key given by its Key::toIndex()
+	void accumulateIndex(const size_t index, const Value &value){
+		static_assert(FixedHLDS::powerFits(alphabetSize, keyLength), "key index does not fit size_t");
+
+		constexpr size_t tailRange = FixedHLDS::power(alphabetSize, tailLength);
+
+		Handle &leaf = this->descendIndex(this->heads[index / tailRange], index % tailRange, Level<0>());
+		if(leaf == Pool::null){
+			this->addNew(leaf, value);
+		}
+		else{
+			this->pool.value(leaf) += value;
+		}
+	}
+
+	// find() for the key given by its Key::toIndex(), nullptr if there is none
+	Value *findValueByIndex(const size_t index){
+		static_assert(std::is_same<ValueStore, PlainValueStore<Value>>::value, "values of this ValueStore have no address");
+		static_assert(FixedHLDS::powerFits(alphabetSize, keyLength), "key index does not fit size_t");
+
+		constexpr size_t tailRange = FixedHLDS::power(alphabetSize, tailLength);
+
+		const Handle leaf = this->findIndex(this->heads[index / tailRange], index % tailRange, Level<0>());
+		return leaf == Pool::null ? nullptr : &this->pool.value(leaf);
+	}
+
+	iterator find(const Key &key){
+		assert(key.size() == keyLength);
+
+		const size_t head = FixedHybridLargeDataStorage::headIndex(key);
+
+		std::array<Handle, tailLength> branch;
+		std::array<uint8_t, tailLength> symbols;
+
+		Handle current = this->heads[head];
+		for(size_t level = 0; level < tailLength; ++level){
+			if(current == Pool::null){
+				return this->end();
+			}
+
+			branch[level] = current;
+			symbols[level] = static_cast<uint8_t>(key[headLength + level].toIndex());
+			current = this->pool.node(current)[symbols[level]];
+		}
+
+		if(current == Pool::null){
+			return this->end();
+		}
+
+		return iterator(this, head, branch, symbols);
+	}
+
+	iterator begin(){
+		return iterator(this, 0);
+	}
+
+	iterator end(){
+		return iterator();
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return headCount * sizeof(Handle) + this->pool.getApproximateRAMUsage();
+	}
+
+	friend class FixedIterator<Key, Value, keyLength, headLength, ValueStore>;
+};
+
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore>
+constexpr size_t FixedHybridLargeDataStorage<Key, Value, keyLength, headLength, ValueStore>::alphabetSize;
+
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore>
+constexpr size_t FixedHybridLargeDataStorage<Key, Value, keyLength, headLength, ValueStore>::tailLength;
+
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore>
+constexpr size_t FixedHybridLargeDataStorage<Key, Value, keyLength, headLength, ValueStore>::headCount;
+
+template<typename Key, typename Value, size_t keyLength, size_t headLength, typename ValueStore>
+constexpr size_t FixedIterator<Key, Value, keyLength, headLength, ValueStore>::tailLength;
+
+#endif // FIXEDHYBRIDLARGEDATASTORAGE_HPP
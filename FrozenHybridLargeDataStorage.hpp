@@ -0,0 +1,403 @@
+#ifndef FROZENHYBRIDLARGEDATASTORAGE_HPP
+#define FROZENHYBRIDLARGEDATASTORAGE_HPP
+
+#include "HLDSDump.hpp"
+#include "MappedFile.hpp"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <limits>
+#include <cstdint>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+template<typename Key, typename Value>
+class HybridLargeDataStorage;
+
+template<typename Key, typename Value>
+class FrozenHybridLargeDataStorage;
+
+template<typename Key, typename Value>
+class FrozenIterator{
+	const FrozenHybridLargeDataStorage<Key, Value> *storage = nullptr;
+	size_t head = 0;
+	size_t position = 0;
+
+public:
+	typedef size_t						difference_type;
+	typedef Value						value_type;
+	typedef const Value *				pointer;
+	typedef const Value &				reference;
+	typedef std::forward_iterator_tag	iterator_category;
+
+	FrozenIterator(){}
+
+	FrozenIterator(const FrozenHybridLargeDataStorage<Key, Value> *storage, const size_t head, const size_t position):
+		storage(storage),
+		head(head),
+		position(position)
+	{
+
+	}
+
+	bool operator==(const FrozenIterator &o) const{
+		return this->position == o.position;
+	}
+
+	bool operator!=(const FrozenIterator &o) const{
+		return !(*this == o);
+	}
+
+	const Value &operator*() const{
+		return this->storage->values[this->position];
+	}
+
+	Key getKey() const{
+		return
+			Key::fromIndex(this->head, this->storage->headSize) +
+			Key::fromIndex(this->storage->tails[this->position], this->storage->tailSize);
+	}
+
+	FrozenIterator &operator++(){
+		++this->position;
+
+		while(this->position >= this->storage->headOffsets[this->head + 1] && this->head + 1 < this->storage->headCount()){
+			++this->head;
+		}
+
+		return *this;
+	}
+};
+
+/*
+ * Read-only counterpart of HybridLargeDataStorage.
+ * Keeps the same head table, but every head is a range of one contiguous
+ * array of sorted tail codes (Key::toIndex() of the tail) with a parallel value array.
+ * The tail of a key must fit into 64 bits as a number in base alphabetSize.
+ *
+ * The arrays contain no pointers, so save() writes them as they are and map()
+ * uses a file written by save() in place. Copies share the (immutable) arrays.
+ */
+template<typename Key, typename Value>
+class FrozenHybridLargeDataStorage{
+	static_assert(std::is_trivially_copyable<Value>::value, "Value must be trivially copyable");
+
+public:
+	typedef FrozenIterator<Key, Value> iterator;
+	typedef FrozenIterator<Key, Value> const_iterator;
+	typedef uint64_t TailCode;
+
+private:
+	static constexpr uint64_t imageMagic = 0x315A52465344484CULL; // "LHDSFRZ1"
+	static constexpr uint64_t imageVersion = 1;
+
+	struct ImageHeader{
+		uint64_t magic;
+		uint64_t version;
+		uint64_t id;
+		uint64_t headSize;
+		uint64_t tailSize;
+		uint64_t valueSize;
+		uint64_t headCount;
+		uint64_t recordCount;
+	};
+
+	struct OwnedArrays{
+		std::vector<uint64_t> headOffsets;
+		std::vector<TailCode> tails;
+		std::vector<Value> values;
+	};
+
+	size_t id;
+	size_t headSize;
+	size_t tailSize;
+
+	std::shared_ptr<const void> backing; // OwnedArrays or MappedFile
+
+	const uint64_t *headOffsets = nullptr;	// head i occupies [headOffsets[i], headOffsets[i + 1])
+	const TailCode *tails = nullptr;
+	const Value *values = nullptr;
+	size_t heads = 0;
+	size_t recordCount = 0;
+
+	// build state
+	std::shared_ptr<OwnedArrays> building;
+
+	FrozenHybridLargeDataStorage(){}
+
+	static size_t power(const size_t exponent){
+		size_t result = 1;
+		for(size_t i = 0; i < exponent; ++i){
+			if(result > std::numeric_limits<TailCode>::max() / Key::value_type::alphabetSize){
+				throw std::overflow_error("Key part does not fit into 64 bits");
+			}
+
+			result *= Key::value_type::alphabetSize;
+		}
+
+		return result;
+	}
+
+	void init(const size_t headSize, const size_t tailSize){
+		this->headSize = headSize;
+		this->tailSize = tailSize;
+
+		FrozenHybridLargeDataStorage::power(this->tailSize);
+
+		this->building = std::make_shared<OwnedArrays>();
+		this->building->headOffsets.assign(FrozenHybridLargeDataStorage::power(this->headSize) + 1, 0);
+	}
+
+	// keys must be appended in ascending order
+	void append(const Key &key, const Value &value){
+		assert(key.size() == this->keySize());
+
+		size_t head = 0;
+		for(size_t i = 0; i < this->headSize; ++i){
+			head = head * Key::value_type::alphabetSize + key[i].toIndex();
+		}
+
+		TailCode tail = 0;
+		for(size_t i = this->headSize; i < key.size(); ++i){
+			tail = tail * Key::value_type::alphabetSize + key[i].toIndex();
+		}
+
+		++this->building->headOffsets[head + 1];
+		this->building->tails.push_back(tail);
+		this->building->values.push_back(value);
+	}
+
+	void finish(){
+		OwnedArrays &arrays = *this->building;
+
+		for(size_t i = 1; i < arrays.headOffsets.size(); ++i){
+			arrays.headOffsets[i] += arrays.headOffsets[i - 1];
+		}
+
+		arrays.tails.shrink_to_fit();
+		arrays.values.shrink_to_fit();
+
+		this->headOffsets = arrays.headOffsets.data();
+		this->tails = arrays.tails.data();
+		this->values = arrays.values.data();
+		this->heads = arrays.headOffsets.size() - 1;
+		this->recordCount = arrays.values.size();
+
+		this->backing = std::move(this->building);
+	}
+
+	size_t headCount() const{
+		return this->heads;
+	}
+
+	// first position in [first, last) holding needle, or last
+	static size_t search(const TailCode *tails, const size_t first, const size_t last, const TailCode needle){
+		if(first == last){
+			return last;
+		}
+
+		const TailCode *base = tails + first;
+		size_t count = last - first;
+
+		while(count > 1){
+			const size_t half = count / 2;
+			base = (base[half] <= needle) ? base + half : base; // compiles to cmov
+			count -= half;
+		}
+
+		return *base == needle ? base - tails : last;
+	}
+
+public:
+	explicit FrozenHybridLargeDataStorage(const HybridLargeDataStorage<Key, Value> &hlds):
+		id(hlds.getId())
+	{
+		this->init(hlds.getHeadSize(), hlds.keySize() - hlds.getHeadSize());
+
+		this->building->tails.reserve(hlds.size());
+		this->building->values.reserve(hlds.size());
+
+		for(auto it = hlds.begin(); it != hlds.end(); ++it){
+			this->append(it.getKey(), *it);
+		}
+
+		this->finish();
+	}
+
+	FrozenHybridLargeDataStorage(HLDSDumpReader<Key, Value> &reader, const size_t headSize):
+		id(reader.getHeader().hldsId)
+	{
+		this->init(headSize, reader.getHeader().keySize - headSize);
+
+		while(reader.hasNext()){
+			const HLDSDumpRecord<Key, Value> record = reader.read();
+			this->append(record.key, record.value);
+		}
+
+		this->finish();
+	}
+
+	size_t keySize() const{
+		return this->headSize + this->tailSize;
+	}
+
+	size_t getId() const{
+		return this->id;
+	}
+
+	size_t size() const{
+		return this->recordCount;
+	}
+
+	const_iterator find(const Key &key) const{
+		assert(key.size() == this->keySize());
+
+		size_t head = 0;
+		for(size_t i = 0; i < this->headSize; ++i){
+			head = head * Key::value_type::alphabetSize + key[i].toIndex();
+		}
+
+		TailCode tail = 0;
+		for(size_t i = this->headSize; i < key.size(); ++i){
+			tail = tail * Key::value_type::alphabetSize + key[i].toIndex();
+		}
+
+		const size_t last = this->headOffsets[head + 1];
+		const size_t position = FrozenHybridLargeDataStorage::search(this->tails, this->headOffsets[head], last, tail);
+
+		if(position == last){
+			return this->end();
+		}
+
+		return const_iterator(this, head, position);
+	}
+
+	const_iterator begin() const{
+		if(this->recordCount == 0){
+			return this->end();
+		}
+
+		size_t head = 0;
+		while(this->headOffsets[head + 1] == 0){
+			++head;
+		}
+
+		return const_iterator(this, head, 0);
+	}
+
+	const_iterator end() const{
+		return const_iterator(this, this->headCount(), this->size());
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return
+			(this->heads + 1) * sizeof(uint64_t) +
+			this->recordCount * sizeof(TailCode) +
+			this->recordCount * sizeof(Value);
+	}
+
+	void save(std::ostream &o) const{
+		o.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+		const ImageHeader header = {
+			imageMagic,
+			imageVersion,
+			this->id,
+			this->headSize,
+			this->tailSize,
+			sizeof(Value),
+			this->heads,
+			this->recordCount
+		};
+
+		writeBinary<ImageHeader>(header, o);
+		o.write(reinterpret_cast<const char *>(this->headOffsets), (this->heads + 1) * sizeof(uint64_t));
+		o.write(reinterpret_cast<const char *>(this->tails), this->recordCount * sizeof(TailCode));
+		o.write(reinterpret_cast<const char *>(this->values), this->recordCount * sizeof(Value));
+	}
+
+	void save(const std::string &path) const{
+		std::ofstream output(path, std::ios_base::binary | std::ios_base::trunc);
+		this->save(output);
+	}
+
+	/*
+	 * Maps an image written by save() read-only: no parsing or copying,
+	 * pages are loaded on demand and shared between processes mapping the same file.
+	 * The image uses the native byte order and must come from the same Key/Value types.
+	 * Header fields are checked against each other and the file size, throws on a mismatch.
+	 */
+	static FrozenHybridLargeDataStorage map(const std::string &path){
+		std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+
+		if(file->size() < sizeof(ImageHeader)){
+			throw std::runtime_error("Not a frozen HLDS image: " + path);
+		}
+
+		const ImageHeader *header = reinterpret_cast<const ImageHeader *>(file->data());
+		if(header->magic != imageMagic || header->version != imageVersion){
+			throw std::runtime_error("Not a frozen HLDS image: " + path);
+		}
+
+		if(header->valueSize != sizeof(Value)){
+			throw std::runtime_error("Value size mismatch in " + path);
+		}
+
+		try{
+			FrozenHybridLargeDataStorage::power(header->tailSize);
+			if(header->headCount != FrozenHybridLargeDataStorage::power(header->headSize)){
+				throw std::runtime_error("Corrupt frozen HLDS image: " + path);
+			}
+		}
+		catch(const std::overflow_error &){
+			throw std::runtime_error("Corrupt frozen HLDS image: " + path);
+		}
+
+		// checked one array at a time so that corrupt counts can't overflow the sizes
+		const size_t available = file->size() - sizeof(ImageHeader);
+		if(header->headCount >= available / sizeof(uint64_t)){
+			throw std::runtime_error("Truncated frozen HLDS image: " + path);
+		}
+
+		const size_t offsetsSize = (header->headCount + 1) * sizeof(uint64_t);
+		if(header->recordCount > (available - offsetsSize) / (sizeof(TailCode) + sizeof(Value))){
+			throw std::runtime_error("Truncated frozen HLDS image: " + path);
+		}
+
+		const size_t tailsSize = header->recordCount * sizeof(TailCode);
+		const size_t valuesSize = header->recordCount * sizeof(Value);
+
+		if(available != offsetsSize + tailsSize + valuesSize){
+			throw std::runtime_error("Truncated frozen HLDS image: " + path);
+		}
+
+		FrozenHybridLargeDataStorage result;
+		result.id = header->id;
+		result.headSize = header->headSize;
+		result.tailSize = header->tailSize;
+		result.heads = header->headCount;
+		result.recordCount = header->recordCount;
+
+		const char *data = file->data() + sizeof(ImageHeader);
+		result.headOffsets = reinterpret_cast<const uint64_t *>(data);
+		result.tails = reinterpret_cast<const TailCode *>(data + offsetsSize);
+		result.values = reinterpret_cast<const Value *>(data + offsetsSize + tailsSize);
+
+		// the offsets in between are trusted, checking them would read the whole table
+		if(result.headOffsets[0] != 0 || result.headOffsets[result.heads] != result.recordCount){
+			throw std::runtime_error("Corrupt frozen HLDS image: " + path);
+		}
+
+		result.backing = std::move(file);
+
+		return result;
+	}
+
+	friend class FrozenIterator<Key, Value>;
+};
+
+#endif // FROZENHYBRIDLARGEDATASTORAGE_HPP
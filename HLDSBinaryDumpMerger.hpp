@@ -2,49 +2,74 @@
 #define HLDSBINARYDUMPMERGER_HPP
 
 #include "HLDSDump.hpp"
+#include "HLDSReducers.hpp"
 
-template<typename Key, typename Value>
+// Reader is HLDSDumpReader or HLDSPrefetchingDumpReader
+template<typename Key, typename Value, typename Reducer = SumReducer<Value>, typename Reader = HLDSDumpReader<Key, Value>>
 class HLDSBinaryDumpMerger{
-	HLDSDumpReader<Key, Value> reader1, reader2;
-	HLDSDumpWriter<Key, Value> writer;
+	typedef typename Reducer::OutValue OutValue;
+
+	Reader reader1, reader2;
+	HLDSDumpWriter<Key, OutValue> writer;
+	const Reducer reducer;
 
 public:
-	HLDSBinaryDumpMerger(std::istream &src1, std::istream &src2, std::ostream &dst): reader1(src1), reader2(src2), writer(dst){
+	HLDSBinaryDumpMerger(std::istream &src1, std::istream &src2, std::ostream &dst, Reducer reducer = Reducer()):
+		reader1(src1),
+		reader2(src2),
+		writer(dst),
+		reducer(std::move(reducer))
+	{
 		assert(reader1.getHeader().hldsId == reader2.getHeader().hldsId);
 		assert(reader1.getHeader().keySize == reader2.getHeader().keySize);
 
 		this->writer.writeHeader(reader1.getHeader());
 	}
 
+private:
+	void writeSingle(const size_t source, const HLDSDumpRecord<Key, Value> &record){
+		OutValue value = this->reducer.identity();
+		this->reducer.accumulate(value, source, record.value);
+
+		if(this->reducer.accept(value)){
+			this->writer.write(HLDSDumpRecord<Key, OutValue>(record.key, std::move(value)));
+		}
+	}
+
+public:
 	void run(){
 		while(this->reader1.hasNext() && this->reader2.hasNext()){
 			if(this->reader1.peek().key == this->reader2.peek().key){
 				const Key key = this->reader1.peek().key;
-				const Value value = this->reader1.peek().value + this->reader2.peek().value;
 
-				this->writer.write(HLDSDumpRecord<Key, Value>(key, value));
+				OutValue value = this->reducer.identity();
+				this->reducer.accumulate(value, 0, this->reader1.peek().value);
+				this->reducer.accumulate(value, 1, this->reader2.peek().value);
+
+				if(this->reducer.accept(value)){
+					this->writer.write(HLDSDumpRecord<Key, OutValue>(key, std::move(value)));
+				}
 
 				this->reader1.read();
 				this->reader2.read();
 			}
 			else if(this->reader1.peek().key < this->reader2.peek().key){
-				this->writer.write(this->reader1.read());
+				this->writeSingle(0, this->reader1.read());
 			}
 			else{
-				this->writer.write(this->reader2.read());
+				this->writeSingle(1, this->reader2.read());
 			}
 		}
 
 		while(this->reader1.hasNext()){
-			this->writer.write(this->reader1.read());
+			this->writeSingle(0, this->reader1.read());
 		}
 
 		while(this->reader2.hasNext()){
-			this->writer.write(this->reader2.read());
+			this->writeSingle(1, this->reader2.read());
 		}
 	}
 
 };
 
 #endif // HLDSBINARYDUMPMERGER_HPP
-
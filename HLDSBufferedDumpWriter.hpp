@@ -0,0 +1,258 @@
+#ifndef HLDSBUFFEREDDUMPWRITER_HPP
+#define HLDSBUFFEREDDUMPWRITER_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HLDSDump.hpp"
+
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <cassert>
+#include <cstdint>
+#include <ostream>
+#include <exception>
+#include <stdexcept>
+#include <condition_variable>
+
+/*
+ * Drop-in for HLDSDumpWriter producing the same bytes. Records are encoded
+ * straight into one of two large buffers (HLDSDumpRecord::encode()), a full
+ * buffer is handed to a background thread that writes it to dst while the
+ * other one fills, so encoding and I/O overlap. Buffers are 4 KiB aligned.
+ *
+ * close() (or the destructor, which swallows errors) writes what is left and
+ * stops the thread, errors of dst are rethrown by the next write() or close().
+ * dst throws on failure while the writer is open, its previous exception mask
+ * is restored by close().
+ */
+template<typename Key, typename Value>
+class HLDSBufferedDumpWriter{
+	static constexpr size_t alignment = 4096;
+
+	struct Buffer{
+		std::unique_ptr<char[]> storage;
+		char *data = nullptr;
+		size_t size = 0;
+	};
+
+	std::ostream &dst;
+	const std::ios_base::iostate dstExceptions;
+	const size_t capacity;
+
+	Buffer buffers[2];
+	Buffer *filling = &buffers[0];
+
+	std::mutex lock;
+	std::condition_variable changed;
+	Buffer *pending = nullptr; // handed to the background thread, nullptr once written
+	bool stopping = false;
+	std::exception_ptr error;
+
+	std::thread background;
+	bool closed = false;
+	size_t bytesWritten = 0;
+
+	void run(){
+		std::unique_lock<std::mutex> guard(this->lock);
+
+		while(true){
+			this->changed.wait(guard, [this](){
+				return this->pending != nullptr || this->stopping;
+			});
+
+			if(this->pending == nullptr){
+				return;
+			}
+
+			Buffer *buffer = this->pending;
+			guard.unlock();
+
+			std::exception_ptr failure;
+			try{
+				this->dst.write(buffer->data, buffer->size);
+			}
+			catch(...){
+				failure = std::current_exception();
+			}
+
+			guard.lock();
+			if(failure && !this->error){
+				this->error = failure;
+			}
+
+			this->pending = nullptr;
+			this->changed.notify_all();
+		}
+	}
+
+	// waits for the background thread to finish the previous buffer, rethrows its error
+	void wait(){
+		std::unique_lock<std::mutex> guard(this->lock);
+		this->changed.wait(guard, [this](){
+			return this->pending == nullptr;
+		});
+
+		if(this->error){
+			std::exception_ptr error = this->error;
+			this->error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	// hands the filling buffer over and continues in the other one
+	void submit(){
+		if(this->filling->size == 0){
+			return;
+		}
+
+		this->wait();
+
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->pending = this->filling;
+			this->changed.notify_all();
+		}
+
+		this->bytesWritten += this->filling->size;
+		this->filling = this->filling == &this->buffers[0] ? &this->buffers[1] : &this->buffers[0];
+		this->filling->size = 0;
+	}
+
+	// room for size more bytes in the filling buffer
+	char *reserve(const size_t size){
+		if(this->closed){
+			throw std::logic_error("HLDSBufferedDumpWriter is closed");
+		}
+
+		if(size > this->capacity){
+			throw std::length_error("bufferSize must hold a record");
+		}
+
+		if(this->filling->size + size > this->capacity){
+			this->submit();
+		}
+
+		char *result = this->filling->data + this->filling->size;
+		this->filling->size += size;
+
+		return result;
+	}
+
+public:
+	// bufferSize is the size of each of the two buffers
+	HLDSBufferedDumpWriter(std::ostream &dst, const size_t bufferSize = 8 << 20):
+		dst(dst),
+		dstExceptions(dst.exceptions()),
+		capacity(bufferSize)
+	{
+		if(bufferSize < alignment){
+			throw std::invalid_argument("bufferSize must be at least 4 KiB");
+		}
+
+		this->dst.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+		for(Buffer &buffer : this->buffers){
+			buffer.storage.reset(new char[bufferSize + alignment - 1]);
+
+			const uintptr_t address = reinterpret_cast<uintptr_t>(buffer.storage.get());
+			buffer.data = buffer.storage.get() + (alignment - address % alignment) % alignment;
+		}
+
+		this->background = std::thread(&HLDSBufferedDumpWriter::run, this);
+	}
+
+	HLDSBufferedDumpWriter(const HLDSBufferedDumpWriter &) = delete;
+	HLDSBufferedDumpWriter &operator=(const HLDSBufferedDumpWriter &) = delete;
+
+	~HLDSBufferedDumpWriter(){
+		try{
+			this->close();
+		}
+		catch(...){
+			// the caller didn't close(), so nobody is left to report to
+		}
+	}
+
+	void writeHeader(const HLDSDumpHeader &header){
+		header.encode(this->reserve(HLDSDumpHeader::serializedSize()));
+	}
+
+	void write(const Key &key, const Value &value){
+		HLDSDumpRecord<Key, Value>::encode(key, value, this->reserve(HLDSDumpRecord<Key, Value>::serializedSize(key.size())));
+	}
+
+	void write(const HLDSDumpRecord<Key, Value> &record){
+		this->write(record.key, record.value);
+	}
+
+	// Storage is HybridLargeDataStorage or any of its read-only counterparts
+	template<typename Storage>
+	void dumpAll(const Storage &hlds){
+		this->writeHeader(HLDSDumpHeader(hlds.getId(), hlds.keySize()));
+
+		for(auto it = hlds.begin(); it != hlds.end(); ++it){
+			this->write(it.getKey(), *it);
+		}
+	}
+
+	// walks the tail trees instead of iterating, see HybridLargeDataStorage::forEachInHeads()
+	void dumpAll(const HybridLargeDataStorage<Key, Value> &hlds){
+		this->writeHeader(HLDSDumpHeader(hlds.getId(), hlds.keySize()));
+
+		hlds.forEachInHeads(0, hlds.getHeadCount(), [this](const Key &key, const Value &value){
+			this->write(key, value);
+		});
+	}
+
+	// writes all buffered records to dst and waits for them, dst is not flushed
+	void flush(){
+		this->submit();
+		this->wait();
+	}
+
+	// flush() and stops the background thread, further writes are not allowed
+	void close(){
+		if(this->closed){
+			return;
+		}
+
+		this->closed = true;
+
+		std::exception_ptr failure;
+		try{
+			this->flush();
+		}
+		catch(...){
+			failure = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->stopping = true;
+			this->changed.notify_all();
+		}
+
+		this->background.join();
+
+		try{
+			this->dst.exceptions(this->dstExceptions);
+		}
+		catch(...){
+			// the restored mask reports a failure already caught above
+		}
+
+		if(failure){
+			std::rethrow_exception(failure);
+		}
+	}
+
+	// bytes handed to dst so far
+	size_t getBytesWritten() const{
+		return this->bytesWritten;
+	}
+};
+
+template<typename Key, typename Value>
+constexpr size_t HLDSBufferedDumpWriter<Key, Value>::alignment;
+
+#endif // HLDSBUFFEREDDUMPWRITER_HPP
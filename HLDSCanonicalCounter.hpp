@@ -0,0 +1,133 @@
+#ifndef HLDSCANONICALCOUNTER_HPP
+#define HLDSCANONICALCOUNTER_HPP
+
+#include "HybridLargeDataStorage.hpp"
+
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+ * Rolling Key::toIndex() codes of the last k symbols of a sequence and of
+ * their reverse complement, updated in O(1) per symbol. Since toIndex() is
+ * big-endian, the smaller code is also the lexicographically smaller key.
+ *
+ * The complement follows the nucleotide symbol order A, T, G, C: symbols 0-3
+ * pair up as index ^ 1, any other symbol (N) is its own complement.
+ * The code must fit size_t, which limits k to 27 for a 5-symbol alphabet.
+ */
+template<typename Key>
+class KmerCodeRoller{
+	size_t k;
+	size_t highestPower = 1; // alphabetSize^(k - 1)
+
+	size_t forwardCode = 0;
+	size_t reverseCode = 0;
+	size_t length = 0;
+
+	static constexpr size_t alphabetSize = Key::value_type::alphabetSize;
+
+public:
+	KmerCodeRoller(const size_t k): k(k){
+		if(this->k == 0){
+			throw std::invalid_argument("k must be positive");
+		}
+
+		for(size_t i = 1; i < this->k; ++i){
+			if(this->highestPower > std::numeric_limits<size_t>::max() / alphabetSize / alphabetSize){
+				throw std::invalid_argument("k-mer code does not fit size_t");
+			}
+
+			this->highestPower *= alphabetSize;
+		}
+	}
+
+	static size_t complement(const size_t symbol){
+		return symbol < 4 ? symbol ^ 1 : symbol;
+	}
+
+	void push(const size_t symbol){
+		this->forwardCode = (this->forwardCode % this->highestPower) * alphabetSize + symbol;
+		this->reverseCode = this->reverseCode / alphabetSize + KmerCodeRoller::complement(symbol) * this->highestPower;
+		++this->length;
+	}
+
+	// true once k symbols were pushed since the last reset()
+	bool ready() const{
+		return this->length >= this->k;
+	}
+
+	size_t forward() const{
+		return this->forwardCode;
+	}
+
+	size_t reverse() const{
+		return this->reverseCode;
+	}
+
+	size_t canonical() const{
+		return std::min(this->forwardCode, this->reverseCode);
+	}
+
+	void reset(){
+		this->forwardCode = 0;
+		this->reverseCode = 0;
+		this->length = 0;
+	}
+};
+
+template<typename Key>
+constexpr size_t KmerCodeRoller<Key>::alphabetSize;
+
+
+/*
+ * Counts canonical k-mers (the smaller of a k-mer and its reverse complement)
+ * of reads into a HybridLargeDataStorage, k being the storage key size.
+ *
+ * Codes are rolled along the read by KmerCodeRoller and the canonical one goes
+ * to accumulateIndex(), so no Key is built per k-mer.
+ */
+template<typename Key, typename Value>
+class HLDSCanonicalCounter{
+	HybridLargeDataStorage<Key, Value> &hlds;
+	KmerCodeRoller<Key> roller;
+
+public:
+	HLDSCanonicalCounter(HybridLargeDataStorage<Key, Value> &hlds): hlds(hlds), roller(hlds.keySize()){}
+
+	// reference implementation working on keys
+	static Key canonical(const Key &key){
+		Key reverseComplement;
+		reverseComplement.reserve(key.size());
+
+		for(auto it = key.crbegin(); it != key.crend(); ++it){
+			reverseComplement.push_back(Key::value_type::fromIndex(KmerCodeRoller<Key>::complement(it->toIndex())));
+		}
+
+		return reverseComplement < key ? reverseComplement : key;
+	}
+
+	// adds value for every k-mer of the read given by a range of key items, returns the number of k-mers
+	template<typename Iterator>
+	size_t addRead(Iterator first, const Iterator last, const Value &value = 1){
+		size_t kmers = 0;
+
+		this->roller.reset();
+		for(; first != last; ++first){
+			this->roller.push(first->toIndex());
+
+			if(this->roller.ready()){
+				this->hlds.accumulateIndex(this->roller.canonical(), value);
+				++kmers;
+			}
+		}
+
+		return kmers;
+	}
+
+	size_t addRead(const Key &read, const Value &value = 1){
+		return this->addRead(read.cbegin(), read.cend(), value);
+	}
+};
+
+#endif // HLDSCANONICALCOUNTER_HPP
@@ -0,0 +1,262 @@
+#ifndef HLDSCHECKPOINTER_HPP
+#define HLDSCHECKPOINTER_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HLDSDump.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+struct HLDSCheckpointInfo{
+	size_t hldsId;
+	size_t headSize;
+	size_t tailSize;
+	uint64_t generation;
+};
+
+/*
+ * Incremental checkpoints of a HybridLargeDataStorage into a directory.
+ *
+ * checkpoint() writes the tails of every head modified since the previous
+ * checkpoint into a new segment file (segment.<generation>), then atomically
+ * replaces MANIFEST, which maps every non-empty head to its latest
+ * (segment, offset, record count). Segments no longer referenced are removed.
+ * A crash at any point leaves the previous manifest and its segments intact.
+ *
+ * Constructing a checkpointer over a directory with a MANIFEST restores it
+ * into the (empty) storage, use peek() to create a matching storage first.
+ *
+ * Heads are tracked as modified when accessed through insert/accumulate/find;
+ * values changed through iterators from begin() are not tracked.
+ */
+template<typename Key, typename Value>
+class HLDSCheckpointer{
+	struct Entry{
+		uint64_t generation;
+		uint64_t offset;
+		uint64_t recordCount;
+	};
+
+	static constexpr uint64_t manifestMagic = 0x31544E4B43534448ULL; // "HDSCKNT1"
+
+	HybridLargeDataStorage<Key, Value> &hlds;
+	const std::string directory;
+
+	std::map<uint64_t, Entry> entries; // by head index
+	uint64_t generation = 0;
+
+	std::string segmentPath(const uint64_t generation) const{
+		return this->directory + "/segment." + std::to_string(generation);
+	}
+
+	std::string manifestPath() const{
+		return this->directory + "/MANIFEST";
+	}
+
+	static void sync(const std::string &path, const int flags){
+		const int fd = ::open(path.c_str(), flags);
+		if(fd < 0){
+			throw std::runtime_error("Can't open " + path + ": " + std::strerror(errno));
+		}
+
+		const int result = ::fsync(fd);
+		::close(fd);
+
+		if(result != 0){
+			throw std::runtime_error("Can't sync " + path + ": " + std::strerror(errno));
+		}
+	}
+
+	static HLDSCheckpointInfo readInfo(std::istream &manifest){
+		if(readBinary<uint64_t>(manifest) != manifestMagic){
+			throw std::runtime_error("Not a checkpoint manifest");
+		}
+
+		HLDSCheckpointInfo info;
+		info.hldsId = readBinary<uint64_t>(manifest);
+		info.headSize = readBinary<uint64_t>(manifest);
+		info.tailSize = readBinary<uint64_t>(manifest);
+		info.generation = readBinary<uint64_t>(manifest);
+
+		return info;
+	}
+
+	void restore(std::istream &manifest){
+		const HLDSCheckpointInfo info = HLDSCheckpointer::readInfo(manifest);
+
+		if(info.headSize != this->hlds.getHeadSize() || info.tailSize + info.headSize != this->hlds.keySize()){
+			throw std::logic_error("Checkpoint was made with different head/tail sizes");
+		}
+
+		if(this->hlds.size() != 0){
+			throw std::logic_error("Checkpoint can only be restored into an empty storage");
+		}
+
+		this->generation = info.generation;
+
+		const uint64_t entryCount = readBinary<uint64_t>(manifest);
+		for(uint64_t i = 0; i < entryCount; ++i){
+			const uint64_t head = readBinary<uint64_t>(manifest);
+			this->entries[head] = readBinary<Entry>(manifest);
+		}
+
+		std::map<uint64_t, std::unique_ptr<std::ifstream>> segments;
+		const size_t tailSize = info.tailSize;
+
+		for(const auto &item : this->entries){
+			std::unique_ptr<std::ifstream> &segment = segments[item.second.generation];
+			if(!segment){
+				segment.reset(new std::ifstream(this->segmentPath(item.second.generation), std::ios_base::binary));
+				segment->exceptions(std::ios_base::failbit | std::ios_base::badbit);
+			}
+
+			segment->seekg(item.second.offset);
+
+			TailTree<Key, Value> &tree = this->hlds.headsHolder.head(item.first);
+			for(uint64_t i = 0; i < item.second.recordCount; ++i){
+				HLDSDumpRecord<Key, Value> record = HLDSDumpRecord<Key, Value>::fromStream(*segment, tailSize);
+				tree.addTail(record.key, std::move(record.value));
+			}
+
+			this->hlds.itemCount += item.second.recordCount;
+		}
+
+		this->hlds.headsHolder.clearDirty();
+	}
+
+public:
+	HLDSCheckpointer(HybridLargeDataStorage<Key, Value> &hlds, std::string directory):
+		hlds(hlds),
+		directory(std::move(directory))
+	{
+		std::ifstream manifest(this->manifestPath(), std::ios_base::binary);
+		if(manifest.is_open()){
+			manifest.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+			this->restore(manifest);
+		}
+	}
+
+	// describes the last checkpoint in the directory, throws if there is none
+	static HLDSCheckpointInfo peek(const std::string &directory){
+		std::ifstream manifest(directory + "/MANIFEST", std::ios_base::binary);
+		if(manifest.is_open() == false){
+			throw std::runtime_error("No checkpoint in " + directory);
+		}
+
+		manifest.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+		return HLDSCheckpointer::readInfo(manifest);
+	}
+
+	uint64_t getGeneration() const{
+		return this->generation;
+	}
+
+	// returns the number of heads written
+	size_t checkpoint(){
+		const uint64_t newGeneration = this->generation + 1;
+		const std::string segmentPath = this->segmentPath(newGeneration);
+
+		std::set<uint64_t> previousSegments;
+		for(const auto &item : this->entries){
+			previousSegments.insert(item.second.generation);
+		}
+
+		// this->entries keeps describing the current MANIFEST until the new one is in place
+		std::map<uint64_t, Entry> updated = this->entries;
+
+		HeadsHolder<Key, Value> &heads = this->hlds.headsHolder;
+		const size_t tailSize = this->hlds.keySize() - this->hlds.getHeadSize();
+		size_t headsWritten = 0;
+		size_t recordsWritten = 0;
+
+		{
+			std::ofstream segment(segmentPath, std::ios_base::binary | std::ios_base::trunc);
+			segment.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+			for(size_t index = 0; index < heads.size(); ++index){
+				if(heads.isDirty(index) == false){
+					continue;
+				}
+
+				++headsWritten;
+
+				const TailTree<Key, Value> &tree = heads.head(index);
+				if(tree.isEmpty()){
+					updated.erase(index);
+					continue;
+				}
+
+				Entry entry = {newGeneration, static_cast<uint64_t>(segment.tellp()), 0};
+				for(auto it = tree.begin(); it != tree.end(); ++it){
+					assert(it.getKey().size() == tailSize);
+					HLDSDumpRecord<Key, Value>(it.getKey(), *it).toStream(segment);
+					++entry.recordCount;
+				}
+
+				recordsWritten += entry.recordCount;
+				updated[index] = entry;
+			}
+		}
+
+		if(recordsWritten > 0){
+			HLDSCheckpointer::sync(segmentPath, O_RDONLY);
+		}
+		else{
+			std::remove(segmentPath.c_str());
+		}
+
+		const std::string temporaryPath = this->manifestPath() + ".tmp";
+		{
+			std::ofstream manifest(temporaryPath, std::ios_base::binary | std::ios_base::trunc);
+			manifest.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+			writeBinary<uint64_t>(manifestMagic, manifest);
+			writeBinary<uint64_t>(this->hlds.getId(), manifest);
+			writeBinary<uint64_t>(this->hlds.getHeadSize(), manifest);
+			writeBinary<uint64_t>(tailSize, manifest);
+			writeBinary<uint64_t>(newGeneration, manifest);
+			writeBinary<uint64_t>(updated.size(), manifest);
+
+			for(const auto &item : updated){
+				writeBinary<uint64_t>(item.first, manifest);
+				writeBinary<Entry>(item.second, manifest);
+			}
+		}
+
+		HLDSCheckpointer::sync(temporaryPath, O_RDONLY);
+		if(std::rename(temporaryPath.c_str(), this->manifestPath().c_str()) != 0){
+			throw std::runtime_error("Can't replace " + this->manifestPath() + ": " + std::strerror(errno));
+		}
+		this->entries.swap(updated);
+		this->generation = newGeneration;
+		HLDSCheckpointer::sync(this->directory, O_RDONLY | O_DIRECTORY);
+
+		heads.clearDirty();
+
+		for(const auto &item : this->entries){
+			previousSegments.erase(item.second.generation);
+		}
+
+		for(const uint64_t unused : previousSegments){
+			std::remove(this->segmentPath(unused).c_str());
+		}
+
+		return headsWritten;
+	}
+};
+
+template<typename Key, typename Value>
+constexpr uint64_t HLDSCheckpointer<Key, Value>::manifestMagic;
+
+#endif // HLDSCHECKPOINTER_HPP
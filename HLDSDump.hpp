@@ -6,6 +6,12 @@
 #include <ostream>
 #include <istream>
 #include <memory>
+#include <type_traits>
+#include <bitset>
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
 
 template<typename T>
 void writeBinary(const T &t, std::ostream &o){
@@ -36,6 +42,12 @@ struct HLDSDumpHeader{
 		writeBinary<size_t>(this->keySize, o);
 	}
 
+	// the bytes of toStream() at dst
+	void encode(char *dst) const{
+		std::memcpy(dst, &this->hldsId, sizeof(size_t));
+		std::memcpy(dst + sizeof(size_t), &this->keySize, sizeof(size_t));
+	}
+
 	static HLDSDumpHeader fromStream(std::istream &i){
 		const size_t hldsId = readBinary<size_t>(i);
 		const size_t keySize = readBinary<size_t>(i);
@@ -51,7 +63,7 @@ struct HLDSDumpRecord{
 
 	HLDSDumpRecord(){}
 	HLDSDumpRecord(Key key, Value value): key(std::move(key)), value(std::move(value)){
-		static_assert(std::is_integral<Value>::value, "Value must be of an integer type");
+		static_assert(std::is_trivially_copyable<Value>::value, "Value must be trivially copyable (an integer or a fixed-width vector of them)");
 	}
 
 	static size_t serializedSize(const size_t keySize){
@@ -62,6 +74,61 @@ struct HLDSDumpRecord{
 		return keySize_byte + valueSize;
 	}
 
+	/*
+	 * Writes the serializedSize(key.size()) bytes of toStream() to dst without
+	 * a temporary: key items are packed through a 64-bit bit accumulator.
+	 */
+	static void encode(const Key &key, const Value &value, char *dst){
+		static_assert(Key::value_type::binarySize <= 56, "a key item must fit the bit accumulator next to a partial byte");
+
+		uint64_t bits = 0;
+		size_t bitCount = 0;
+
+		for(const auto &keyItem : key){
+			bits |= static_cast<uint64_t>(keyItem.toBitset().to_ullong()) << bitCount;
+			bitCount += Key::value_type::binarySize;
+
+			while(bitCount >= 8){
+				*dst++ = static_cast<char>(bits & 0xFF);
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+
+		if(bitCount != 0){
+			*dst++ = static_cast<char>(bits);
+		}
+
+		std::memcpy(dst, &value, sizeof(Value));
+	}
+
+	// inverse of encode(), reads serializedSize(keySize) bytes from src
+	static HLDSDumpRecord decode(const char *src, const size_t keySize){
+		constexpr uint64_t itemMask = (uint64_t(1) << Key::value_type::binarySize) - 1;
+
+		uint64_t bits = 0;
+		size_t bitCount = 0;
+
+		Key key;
+		key.reserve(keySize);
+
+		for(size_t keyIndex = 0; keyIndex < keySize; ++keyIndex){
+			while(bitCount < Key::value_type::binarySize){
+				bits |= static_cast<uint64_t>(static_cast<unsigned char>(*src++)) << bitCount;
+				bitCount += 8;
+			}
+
+			key.push_back(Key::value_type::fromBitset(std::bitset<Key::value_type::binarySize>(bits & itemMask)));
+			bits >>= Key::value_type::binarySize;
+			bitCount -= Key::value_type::binarySize;
+		}
+
+		Value value;
+		std::memcpy(&value, src, sizeof(Value));
+
+		return HLDSDumpRecord(std::move(key), std::move(value));
+	}
+
 	void toStream(std::ostream &o) const{
 		const size_t keySize_bit = this->key.size() * Key::value_type::binarySize;
 		const size_t keySize_byte = keySize_bit / 8 + (keySize_bit % 8 ? 1 : 0);
@@ -115,6 +182,9 @@ struct HLDSDumpRecord{
 };
 
 
+template<typename Key, typename Value>
+class HybridLargeDataStorage;
+
 template<typename Key, typename Value>
 class HLDSDumpWriter{
 	std::ostream &dst;
@@ -132,7 +202,9 @@ public:
 		record.toStream(this->dst);
 	}
 
-	void dumpAll(HybridLargeDataStorage<Key, Value> &hlds){
+	// Storage is HybridLargeDataStorage or any of its read-only counterparts
+	template<typename Storage>
+	void dumpAll(Storage &hlds){
 		this->writeHeader(HLDSDumpHeader(hlds.getId(), hlds.keySize()));
 
 		for(auto it = hlds.begin(); it != hlds.end(); ++it){
@@ -140,6 +212,19 @@ public:
 			this->write(record);
 		}
 	}
+
+	// walks the tail trees read-only, so heads shared with a snapshot are not copied
+	void dumpAll(const HybridLargeDataStorage<Key, Value> &hlds){
+		this->writeHeader(HLDSDumpHeader(hlds.getId(), hlds.keySize()));
+
+		hlds.forEachInHeads(0, hlds.getHeadCount(), [this](const Key &key, const Value &value){
+			this->write(HLDSDumpRecord<Key, Value>(key, value));
+		});
+	}
+
+	void dumpAll(HybridLargeDataStorage<Key, Value> &hlds){
+		this->dumpAll(static_cast<const HybridLargeDataStorage<Key, Value> &>(hlds));
+	}
 };
 
 
@@ -0,0 +1,81 @@
+#ifndef HLDSDUMPMERGER_HPP
+#define HLDSDUMPMERGER_HPP
+
+#include "HLDSDump.hpp"
+#include "HLDSReducers.hpp"
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+/*
+ * Merges any number of sorted dumps in a single pass.
+ * Source index passed to the reducer is the position of the stream in `sources`,
+ * so e.g. SampleCountReducer turns N sample dumps into a key x sample matrix.
+ * Reader is HLDSDumpReader or HLDSPrefetchingDumpReader, the latter keeps
+ * every source streaming when many are interleaved.
+ */
+template<typename Key, typename Reducer, typename Reader = HLDSDumpReader<Key, typename Reducer::InValue>>
+class HLDSDumpMerger{
+	typedef typename Reducer::InValue InValue;
+	typedef typename Reducer::OutValue OutValue;
+
+	std::vector<std::unique_ptr<Reader>> readers;
+	HLDSDumpWriter<Key, OutValue> writer;
+	const Reducer reducer;
+
+public:
+	HLDSDumpMerger(const std::vector<std::istream *> &sources, std::ostream &dst, Reducer reducer = Reducer()):
+		writer(dst),
+		reducer(std::move(reducer))
+	{
+		if(sources.empty()){
+			throw std::invalid_argument("At least one source dump is required");
+		}
+
+		this->readers.reserve(sources.size());
+		for(std::istream *src : sources){
+			this->readers.emplace_back(new Reader(*src));
+			assert(this->readers.front()->getHeader().keySize == this->readers.back()->getHeader().keySize);
+		}
+
+		this->writer.writeHeader(this->readers.front()->getHeader());
+	}
+
+private:
+	const Key *smallestKey() const{
+		const Key *result = nullptr;
+
+		for(const auto &reader : this->readers){
+			if(reader->hasNext() && (result == nullptr || reader->peek().key < *result)){
+				result = &reader->peek().key;
+			}
+		}
+
+		return result;
+	}
+
+public:
+	void run(){
+		const Key *smallest = nullptr;
+
+		while((smallest = this->smallestKey()) != nullptr){
+			const Key key = *smallest;
+			OutValue value = this->reducer.identity();
+
+			for(size_t source = 0; source < this->readers.size(); ++source){
+				Reader &reader = *this->readers.at(source);
+
+				if(reader.hasNext() && reader.peek().key == key){
+					this->reducer.accumulate(value, source, reader.read().value);
+				}
+			}
+
+			if(this->reducer.accept(value)){
+				this->writer.write(HLDSDumpRecord<Key, OutValue>(key, std::move(value)));
+			}
+		}
+	}
+};
+
+#endif // HLDSDUMPMERGER_HPP
@@ -0,0 +1,175 @@
+#ifndef HLDSDUMPSETOPERATIONS_HPP
+#define HLDSDUMPSETOPERATIONS_HPP
+
+#include "HLDSDump.hpp"
+#include "HLDSReducers.hpp"
+
+#include <memory>
+#include <algorithm>
+
+enum class HLDSDumpSetOperation{
+	intersection,			// keys present in both dumps
+	difference,				// keys present in the first dump only
+	symmetricDifference		// keys present in exactly one of the dumps
+};
+
+struct HLDSDumpSimilarity{
+	size_t firstOnly = 0;
+	size_t secondOnly = 0;
+	size_t shared = 0;
+
+	double sharedWeight = 0;	// sum of min(value1, value2) over shared keys
+	double totalWeight = 0;		// sum of max(value1, value2) over all keys
+
+	size_t unionSize() const{
+		return this->firstOnly + this->secondOnly + this->shared;
+	}
+
+	double jaccard() const{
+		return this->unionSize() == 0 ? 1.0 : static_cast<double>(this->shared) / this->unionSize();
+	}
+
+	double weightedJaccard() const{
+		return this->totalWeight == 0 ? 1.0 : this->sharedWeight / this->totalWeight;
+	}
+
+	// fraction of the first dump's keys which are also present in the second one
+	double containmentOfFirst() const{
+		const size_t firstSize = this->firstOnly + this->shared;
+		return firstSize == 0 ? 1.0 : static_cast<double>(this->shared) / firstSize;
+	}
+
+	double containmentOfSecond() const{
+		const size_t secondSize = this->secondOnly + this->shared;
+		return secondSize == 0 ? 1.0 : static_cast<double>(this->shared) / secondSize;
+	}
+};
+
+/*
+ * Linear merge-join of two sorted dumps. Never builds a tree: memory usage
+ * is two records regardless of the dump sizes.
+ * Values of the emitted records go through the reducer (source 0 is the first dump),
+ * the similarity statistics are collected on every run.
+ */
+template<typename Key, typename Value, typename Reducer = SumReducer<Value>>
+class HLDSDumpSetOperator{
+	typedef typename Reducer::OutValue OutValue;
+
+	HLDSDumpReader<Key, Value> reader1, reader2;
+	std::unique_ptr<HLDSDumpWriter<Key, OutValue>> writer;
+	const HLDSDumpSetOperation operation;
+	const Reducer reducer;
+
+public:
+	HLDSDumpSetOperator(
+		std::istream &src1,
+		std::istream &src2,
+		std::ostream &dst,
+		const HLDSDumpSetOperation operation,
+		Reducer reducer = Reducer()
+	):
+		reader1(src1),
+		reader2(src2),
+		writer(new HLDSDumpWriter<Key, OutValue>(dst)),
+		operation(operation),
+		reducer(std::move(reducer))
+	{
+		assert(reader1.getHeader().keySize == reader2.getHeader().keySize);
+
+		this->writer->writeHeader(reader1.getHeader());
+	}
+
+	// statistics only, nothing is written
+	HLDSDumpSetOperator(std::istream &src1, std::istream &src2):
+		reader1(src1),
+		reader2(src2),
+		operation(HLDSDumpSetOperation::intersection),
+		reducer()
+	{
+		assert(reader1.getHeader().keySize == reader2.getHeader().keySize);
+	}
+
+private:
+	bool emitsShared() const{
+		return this->operation == HLDSDumpSetOperation::intersection;
+	}
+
+	bool emitsFirstOnly() const{
+		return this->operation != HLDSDumpSetOperation::intersection;
+	}
+
+	bool emitsSecondOnly() const{
+		return this->operation == HLDSDumpSetOperation::symmetricDifference;
+	}
+
+	void emit(const Key &key, const OutValue &value){
+		if(this->writer && this->reducer.accept(value)){
+			this->writer->write(HLDSDumpRecord<Key, OutValue>(key, value));
+		}
+	}
+
+	void single(const size_t source, const HLDSDumpRecord<Key, Value> &record, HLDSDumpSimilarity &similarity){
+		similarity.totalWeight += static_cast<double>(record.value);
+
+		if(source == 0){
+			++similarity.firstOnly;
+			if(this->emitsFirstOnly() == false){
+				return;
+			}
+		}
+		else{
+			++similarity.secondOnly;
+			if(this->emitsSecondOnly() == false){
+				return;
+			}
+		}
+
+		OutValue value = this->reducer.identity();
+		this->reducer.accumulate(value, source, record.value);
+		this->emit(record.key, value);
+	}
+
+public:
+	HLDSDumpSimilarity run(){
+		HLDSDumpSimilarity similarity;
+
+		while(this->reader1.hasNext() && this->reader2.hasNext()){
+			const HLDSDumpRecord<Key, Value> &record1 = this->reader1.peek();
+			const HLDSDumpRecord<Key, Value> &record2 = this->reader2.peek();
+
+			if(record1.key == record2.key){
+				++similarity.shared;
+				similarity.sharedWeight += static_cast<double>(std::min(record1.value, record2.value));
+				similarity.totalWeight += static_cast<double>(std::max(record1.value, record2.value));
+
+				if(this->emitsShared()){
+					OutValue value = this->reducer.identity();
+					this->reducer.accumulate(value, 0, record1.value);
+					this->reducer.accumulate(value, 1, record2.value);
+					this->emit(record1.key, value);
+				}
+
+				this->reader1.read();
+				this->reader2.read();
+			}
+			else if(record1.key < record2.key){
+				this->single(0, this->reader1.read(), similarity);
+			}
+			else{
+				this->single(1, this->reader2.read(), similarity);
+			}
+		}
+
+		while(this->reader1.hasNext()){
+			this->single(0, this->reader1.read(), similarity);
+		}
+
+		while(this->reader2.hasNext()){
+			this->single(1, this->reader2.read(), similarity);
+		}
+
+		return similarity;
+	}
+};
+
+#endif // HLDSDUMPSETOPERATIONS_HPP
@@ -0,0 +1,148 @@
+#ifndef HLDSEXTERNALCOUNTER_HPP
+#define HLDSEXTERNALCOUNTER_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HLDSDump.hpp"
+#include "HLDSDumpMerger.hpp"
+#include "HLDSReducers.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <cstdio>
+#include <stdexcept>
+
+/*
+ * Counts keys under a fixed RAM budget.
+ * Once getApproximateRAMUsage() of the in-memory instance exceeds the budget,
+ * the instance is dumped into a sorted run file and cleared.
+ * finish() merges all runs (at most maxFanIn at a time) into the destination dump.
+ */
+template<typename Key, typename Value>
+class HLDSExternalCounter{
+	HybridLargeDataStorage<Key, Value> hlds;
+	const size_t ramBudget;
+	const std::string runPathPrefix;
+	const size_t maxFanIn;
+
+	std::vector<std::string> runs;
+	size_t runsCreated = 0;
+
+public:
+	HLDSExternalCounter(
+		const size_t headSize,
+		const size_t tailSize,
+		const size_t ramBudget,
+		std::string runPathPrefix,
+		const size_t maxFanIn = 64
+	):
+		hlds(headSize, tailSize),
+		ramBudget(ramBudget),
+		runPathPrefix(std::move(runPathPrefix)),
+		maxFanIn(maxFanIn)
+	{
+		if(this->ramBudget <= this->hlds.getApproximateRAMUsage()){
+			throw std::invalid_argument("RAM budget is smaller than an empty instance");
+		}
+
+		if(this->maxFanIn < 2){
+			throw std::invalid_argument("maxFanIn must be at least 2");
+		}
+	}
+
+	HLDSExternalCounter(const HLDSExternalCounter &) = delete;
+	HLDSExternalCounter &operator=(const HLDSExternalCounter &) = delete;
+
+	~HLDSExternalCounter(){
+		for(const std::string &run : this->runs){
+			std::remove(run.c_str());
+		}
+	}
+
+	void add(Key key, const Value &value = 1){
+		this->hlds.accumulate(std::move(key), value);
+
+		if(this->hlds.getApproximateRAMUsage() > this->ramBudget){
+			this->spill();
+		}
+	}
+
+	size_t runCount() const{
+		return this->runs.size();
+	}
+
+	void finish(std::ostream &dst){
+		if(this->runs.empty()){
+			HLDSDumpWriter<Key, Value>(dst).dumpAll(this->hlds);
+			this->hlds.clear();
+			return;
+		}
+
+		this->spill();
+
+		// runs (and a partial output) stay listed until their merge succeeded, so the destructor removes them on failure
+		while(this->runs.size() > this->maxFanIn){
+			const std::vector<std::string> group(this->runs.begin(), this->runs.begin() + this->maxFanIn);
+
+			const std::string path = this->nextRunPath();
+			this->runs.push_back(path);
+			{
+				std::ofstream output(path, std::ios_base::binary);
+				this->mergeRuns(group, output);
+			}
+			this->runs.erase(this->runs.begin(), this->runs.begin() + this->maxFanIn);
+		}
+
+		this->mergeRuns(this->runs, dst);
+		this->runs.clear();
+	}
+
+private:
+	std::string nextRunPath(){
+		return this->runPathPrefix + "." + std::to_string(this->runsCreated++);
+	}
+
+	void spill(){
+		if(this->hlds.size() == 0){
+			return;
+		}
+
+		const std::string path = this->nextRunPath();
+		try{
+			std::ofstream output(path, std::ios_base::binary);
+			HLDSDumpWriter<Key, Value>(output).dumpAll(this->hlds);
+		}
+		catch(...){
+			std::remove(path.c_str());
+			throw;
+		}
+
+		this->runs.push_back(path);
+		this->hlds.clear();
+	}
+
+	void mergeRuns(const std::vector<std::string> &group, std::ostream &dst){
+		std::vector<std::unique_ptr<std::ifstream>> inputs;
+		std::vector<std::istream *> sources;
+
+		for(const std::string &run : group){
+			inputs.emplace_back(new std::ifstream(run, std::ios_base::binary));
+			if(inputs.back()->is_open() == false){
+				throw std::runtime_error("Can't open run file " + run);
+			}
+
+			sources.push_back(inputs.back().get());
+		}
+
+		HLDSDumpMerger<Key, SumReducer<Value>> merger(sources, dst);
+		merger.run();
+
+		inputs.clear();
+		for(const std::string &run : group){
+			std::remove(run.c_str());
+		}
+	}
+};
+
+#endif // HLDSEXTERNALCOUNTER_HPP
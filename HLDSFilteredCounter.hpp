@@ -0,0 +1,97 @@
+#ifndef HLDSFILTEREDCOUNTER_HPP
+#define HLDSFILTEREDCOUNTER_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HLDSCanonicalCounter.hpp"
+#include "BlockedBloomFilter.hpp"
+
+#include <stdexcept>
+
+/*
+ * Counts k-mers of reads into a HybridLargeDataStorage (k is the storage key size)
+ * behind a BlockedBloomFilter, so k-mers seen once, mostly sequencing errors,
+ * never allocate trie nodes. A k-mer missing from the storage is inserted with
+ * a count of 2 on its second sighting, i.e. once the filter already holds it.
+ *
+ * A filter false positive inserts a k-mer on its first sighting with one
+ * occurrence too many. For exact counts stream the same reads again after
+ * startCorrection(): all stored counts restart from zero and only stored k-mers
+ * are counted. Stored k-mers are then the ones seen twice or more plus about
+ * the false positive rate of the singletons, all with exact counts.
+ */
+template<typename Key, typename Value>
+class HLDSFilteredCounter{
+	HybridLargeDataStorage<Key, Value> &hlds;
+	BlockedBloomFilter filter;
+	KmerCodeRoller<Key> roller;
+	const bool canonical;
+	bool correcting = false;
+
+	void add(const size_t code){
+		Value *value = this->hlds.findValueByIndex(code);
+
+		if(value != nullptr){
+			*value += 1;
+		}
+		else if(!this->correcting && this->filter.testAndSet(code)){
+			this->hlds.accumulateIndex(code, 2);
+		}
+	}
+
+public:
+	HLDSFilteredCounter(
+		HybridLargeDataStorage<Key, Value> &hlds,
+		const size_t expectedDistinctKmers,
+		const size_t bitsPerKmer = 8,
+		const bool canonical = true
+	):
+		hlds(hlds),
+		filter(expectedDistinctKmers, bitsPerKmer),
+		roller(hlds.keySize()),
+		canonical(canonical){}
+
+	// counts every k-mer of the read given by a range of key items, returns the number of k-mers
+	template<typename Iterator>
+	size_t addRead(Iterator first, const Iterator last){
+		size_t kmers = 0;
+
+		this->roller.reset();
+		for(; first != last; ++first){
+			this->roller.push(first->toIndex());
+
+			if(this->roller.ready()){
+				this->add(this->canonical ? this->roller.canonical() : this->roller.forward());
+				++kmers;
+			}
+		}
+
+		return kmers;
+	}
+
+	size_t addRead(const Key &read){
+		return this->addRead(read.cbegin(), read.cend());
+	}
+
+	// zeroes the stored counts, from now on addRead() only counts k-mers already stored
+	void startCorrection(){
+		if(this->correcting){
+			throw std::logic_error("Correction has already started");
+		}
+
+		for(auto it = this->hlds.begin(); it != this->hlds.end(); ++it){
+			*it = Value();
+		}
+
+		this->correcting = true;
+	}
+
+	bool isCorrecting() const{
+		return this->correcting;
+	}
+
+	const BlockedBloomFilter &getFilter() const{
+		return this->filter;
+	}
+};
+
+#endif // HLDSFILTEREDCOUNTER_HPP
@@ -6,16 +6,30 @@
 
 #include <utility>
 #include <iterator>
+#include <type_traits>
 
 template<typename Key, typename Value>
 class HybridLargeDataStorage;
 
-template<typename Key, typename Value>
+// the isConst iterator reads through const tail trees only, so it never copies shared heads
+template<typename Key, typename Value, bool isConst = false>
 class HLDSIterator{
-	typename HeadsHolder<Key, Value>::iterator headsIterator;
-	const typename HeadsHolder<Key, Value>::iterator headsEnd;
-	typename TailTree<Key, Value>::iterator tailIterator;
-	const typename TailTree<Key, Value>::iterator tailEnd;
+	typedef typename std::conditional<
+		isConst,
+		typename HeadsHolder<Key, Value>::const_iterator,
+		typename HeadsHolder<Key, Value>::iterator
+	>::type HeadsIterator;
+
+	typedef typename std::conditional<
+		isConst,
+		typename TailTree<Key, Value>::const_iterator,
+		typename TailTree<Key, Value>::iterator
+	>::type TailIterator;
+
+	HeadsIterator headsIterator;
+	const HeadsIterator headsEnd;
+	TailIterator tailIterator;
+	const TailIterator tailEnd;
 
 	bool isSet;
 
@@ -27,18 +41,18 @@ protected:
 public:
 	typedef size_t						difference_type;
 	typedef Value						value_type;
-	typedef Value *						pointer;
-	typedef Value &						reference;
+	typedef typename std::conditional<isConst, const Value *, Value *>::type	pointer;
+	typedef typename std::conditional<isConst, const Value &, Value &>::type	reference;
 	typedef std::forward_iterator_tag	iterator_category;
 
 
 	HLDSIterator(): isSet(false){}
 
 	HLDSIterator(
-		const typename HeadsHolder<Key, Value>::iterator headsIterator,
-		const typename HeadsHolder<Key, Value>::iterator headsEnd,
-		const typename TailTree<Key, Value>::iterator tailIterator,
-		const typename TailTree<Key, Value>::iterator tailEnd
+		const HeadsIterator headsIterator,
+		const HeadsIterator headsEnd,
+		const TailIterator tailIterator,
+		const TailIterator tailEnd
 	): headsIterator(std::move(headsIterator)), headsEnd(std::move(headsEnd)), tailIterator(std::move(tailIterator)), tailEnd(std::move(tailEnd)), isSet(true)
 	{
 
@@ -56,7 +70,11 @@ public:
 		return this->headsIterator == o.headsIterator && this->tailIterator == o.tailIterator;
 	}
 
-	Value &operator*(){
+	bool operator!=(const HLDSIterator &o) const{
+		return !(*this == o);
+	}
+
+	reference operator*(){
 		return *this->tailIterator;
 	}
 
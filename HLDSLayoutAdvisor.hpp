@@ -0,0 +1,135 @@
+#ifndef HLDSLAYOUTADVISOR_HPP
+#define HLDSLAYOUTADVISOR_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HyperLogLog.hpp"
+
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+ * Picks the head/tail split of a HybridLargeDataStorage for the number of
+ * distinct keys, counted by a HyperLogLog sketch over a sample of the input
+ * or over the whole ingest.
+ *
+ * The RAM model follows getApproximateRAMUsage(): the heads table plus one
+ * Node per distinct key prefix longer than the head plus one ValueNode per key,
+ * with prefixes spread uniformly over usedSymbols symbols. usedSymbols defaults
+ * to the whole alphabet, pass 4 for nucleotide data where N is rare.
+ *
+ * A lookup indexes the heads table once and then follows one pointer per tail
+ * symbol, so its depth is the tail length. Heads shorter than the RAM minimum
+ * cost both more RAM and more depth. Longer heads trade RAM for depth, and
+ * the heads table grows alphabetSize times per symbol. The recommendation
+ * is the shallowest layout whose estimated RAM stays within ramTolerance
+ * (10% by default) of the minimum.
+ */
+template<typename Key, typename Value>
+class HLDSLayoutAdvisor{
+	const size_t keySize;
+	const size_t usedSymbols;
+	HyperLogLog sketch;
+
+public:
+	HLDSLayoutAdvisor(const size_t keySize, const size_t precision = 14, const size_t usedSymbols = Key::value_type::alphabetSize):
+		keySize(keySize),
+		usedSymbols(usedSymbols),
+		sketch(precision)
+	{
+		if(keySize < 2){
+			throw std::invalid_argument("keySize must be at least 2");
+		}
+	}
+
+	void add(const Key &key){
+		assert(key.size() == this->keySize);
+
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for(const typename Key::value_type &keyItem : key){
+			hash = (hash ^ keyItem.toIndex()) * 0x100000001b3ULL;
+		}
+
+		this->sketch.add(hash);
+	}
+
+	// add() for the key given by its Key::toIndex()
+	void addIndex(const size_t index){
+		this->sketch.add(index);
+	}
+
+	double estimateDistinct() const{
+		return this->sketch.estimate();
+	}
+
+	const HyperLogLog &getSketch() const{
+		return this->sketch;
+	}
+
+	static double estimateRAMUsage(const size_t keySize, const size_t headSize, const double distinct, const size_t usedSymbols){
+		const double heads = std::pow(static_cast<double>(Key::value_type::alphabetSize), static_cast<double>(headSize));
+
+		double nodes = 0;
+		for(size_t prefix = headSize; prefix < keySize; ++prefix){
+			const double prefixes = std::pow(static_cast<double>(usedSymbols), static_cast<double>(prefix));
+			nodes += prefixes * -std::expm1(-distinct / prefixes);
+		}
+
+		return
+			heads * sizeof(typename HeadsHolder<Key, Value>::value_type) +
+			nodes * sizeof(Node<Key, Value>) +
+			distinct * sizeof(ValueNode<Key, Value>);
+	}
+
+	// pointers followed below the heads table by a lookup
+	static size_t lookupDepth(const size_t keySize, const size_t headSize){
+		return keySize - headSize;
+	}
+
+	static size_t recommendHeadSize(const size_t keySize, const double distinct, const size_t usedSymbols = Key::value_type::alphabetSize, const double ramTolerance = 0.1){
+		std::vector<double> ram;
+		double minimum = std::numeric_limits<double>::max();
+
+		for(size_t headSize = 0; headSize < keySize; ++headSize){
+			ram.push_back(HLDSLayoutAdvisor::estimateRAMUsage(keySize, headSize, distinct, usedSymbols));
+			minimum = std::min(minimum, ram.back());
+
+			// the heads table alone is out of the tolerance, so are all longer heads
+			if(std::pow(static_cast<double>(Key::value_type::alphabetSize), static_cast<double>(headSize)) * sizeof(typename HeadsHolder<Key, Value>::value_type) > (1.0 + ramTolerance) * minimum){
+				break;
+			}
+		}
+
+		// lookupDepth() falls with the head size, so the longest head within the tolerance is the shallowest
+		size_t result = 0;
+		for(size_t headSize = 0; headSize < ram.size(); ++headSize){
+			if(ram[headSize] <= minimum * (1.0 + ramTolerance)){
+				result = headSize;
+			}
+		}
+
+		return result;
+	}
+
+	size_t recommendHeadSize(const double ramTolerance = 0.1) const{
+		return HLDSLayoutAdvisor::recommendHeadSize(this->keySize, this->estimateDistinct(), this->usedSymbols, ramTolerance);
+	}
+
+	// copy of source with another head/tail split and the same id, takes the RAM of both until source is dropped
+	static HybridLargeDataStorage<Key, Value> rebuild(const HybridLargeDataStorage<Key, Value> &source, const size_t headSize){
+		if(headSize >= source.keySize()){
+			throw std::invalid_argument("headSize must leave a non-empty tail");
+		}
+
+		HybridLargeDataStorage<Key, Value> result(source.getId(), headSize, source.keySize() - headSize);
+
+		for(auto it = source.begin(); it != source.end(); ++it){
+			result.insert(it.getKey(), *it);
+		}
+
+		return result;
+	}
+};
+
+#endif // HLDSLAYOUTADVISOR_HPP
@@ -0,0 +1,288 @@
+#ifndef HLDSMINIMIZERBUCKETER_HPP
+#define HLDSMINIMIZERBUCKETER_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HLDSCanonicalCounter.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+/*
+ * Ingest stage for k-mer counting into a HybridLargeDataStorage (k is the storage key size).
+ *
+ * addRead() splits a read into super-k-mers, maximal runs of consecutive k-mers
+ * sharing a minimizer (the m-mer with the smallest hash among the k - m + 1 m-mers
+ * of a k-mer), and appends each one as k - 1 + run length symbols to the bucket
+ * chosen by its minimizer. flush() then counts one bucket at a time: the k-mer codes
+ * of a bucket are sorted and equal ones collapsed before going to accumulateIndex(),
+ * so the storage is walked in key order once per bucket instead of randomly once per k-mer.
+ *
+ * Heads stay the key prefix (dumps and merges rely on key order), so buckets of
+ * different threads may meet in the same head: with threadCount > 1 heads are
+ * locked in groups of 64 (one word of the dirty bitmap), paging must be off.
+ */
+template<typename Key, typename Value>
+class HLDSMinimizerBucketer{
+	struct Bucket{
+		std::vector<uint8_t> symbols;
+		std::vector<size_t> ends; // end of every super-k-mer in symbols
+	};
+
+	static constexpr size_t headsPerLock = 64;
+	static constexpr size_t lockCount = 1024;
+
+	HybridLargeDataStorage<Key, Value> &hlds;
+	const size_t k;
+	const size_t minimizerSize;
+	const bool canonical;
+	const size_t threadCount;
+	size_t tailRange = 1; // alphabetSize^tailSize
+
+	std::vector<Bucket> buckets;
+	std::unique_ptr<std::mutex[]> locks;
+
+	const KmerCodeRoller<Key> kmerRoller; // copied by every flush() worker
+	KmerCodeRoller<Key> minimizerRoller;
+	std::vector<uint8_t> readSymbols;
+	std::vector<uint64_t> minimizerHashes;
+
+	size_t bufferedKmers = 0;
+	size_t superKmerCount = 0;
+	size_t kmerCount = 0;
+
+	static uint64_t hash(uint64_t code){
+		code ^= code >> 33;
+		code *= 0xff51afd7ed558ccdULL;
+		code ^= code >> 33;
+		code *= 0xc4ceb9fe1a85ec53ULL;
+		code ^= code >> 33;
+
+		return code;
+	}
+
+	void emit(const size_t firstKmer, const size_t lastKmer, const uint64_t minimizerHash){
+		Bucket &bucket = this->buckets[minimizerHash % this->buckets.size()];
+
+		bucket.symbols.insert(bucket.symbols.end(), this->readSymbols.cbegin() + firstKmer, this->readSymbols.cbegin() + lastKmer + this->k);
+		bucket.ends.push_back(bucket.symbols.size());
+
+		this->bufferedKmers += lastKmer - firstKmer + 1;
+		++this->superKmerCount;
+	}
+
+	void countBucket(const Bucket &bucket, KmerCodeRoller<Key> &roller, std::vector<size_t> &codes){
+		codes.clear();
+
+		size_t begin = 0;
+		for(const size_t end : bucket.ends){
+			roller.reset();
+
+			for(size_t i = begin; i < end; ++i){
+				roller.push(bucket.symbols[i]);
+
+				if(roller.ready()){
+					codes.push_back(this->canonical ? roller.canonical() : roller.forward());
+				}
+			}
+
+			begin = end;
+		}
+
+		std::sort(codes.begin(), codes.end());
+
+		// groups wrap around the lock array, so only one lock is ever held to keep the order irrelevant
+		std::unique_lock<std::mutex> lock;
+		size_t lockedSlot = 0;
+
+		for(size_t i = 0; i < codes.size();){
+			size_t j = i + 1;
+			while(j < codes.size() && codes[j] == codes[i]){
+				++j;
+			}
+
+			if(this->threadCount > 1){
+				const size_t slot = codes[i] / this->tailRange / headsPerLock % lockCount;
+
+				if(!lock.owns_lock() || slot != lockedSlot){
+					if(lock.owns_lock()){
+						lock.unlock();
+					}
+
+					lock = std::unique_lock<std::mutex>(this->locks[slot]);
+					lockedSlot = slot;
+				}
+			}
+
+			this->hlds.accumulateIndex(codes[i], static_cast<Value>(j - i));
+			i = j;
+		}
+	}
+
+public:
+	HLDSMinimizerBucketer(
+		HybridLargeDataStorage<Key, Value> &hlds,
+		const size_t minimizerSize,
+		const size_t bucketCount = 256,
+		const bool canonical = true,
+		const size_t threadCount = 1
+	):
+		hlds(hlds),
+		k(hlds.keySize()),
+		minimizerSize(minimizerSize),
+		canonical(canonical),
+		threadCount(threadCount),
+		buckets(bucketCount),
+		locks(new std::mutex[lockCount]),
+		kmerRoller(this->k),
+		minimizerRoller(minimizerSize)
+	{
+		if(this->minimizerSize > this->k){
+			throw std::invalid_argument("minimizerSize must not exceed the key size");
+		}
+
+		if(bucketCount == 0 || threadCount == 0){
+			throw std::invalid_argument("bucketCount and threadCount must be positive");
+		}
+
+		for(size_t i = hlds.getHeadSize(); i < this->k; ++i){
+			this->tailRange *= Key::value_type::alphabetSize;
+		}
+	}
+
+	// buffers every k-mer of the read given by a range of key items, returns the number of k-mers
+	template<typename Iterator>
+	size_t addRead(Iterator first, const Iterator last){
+		this->readSymbols.clear();
+		for(; first != last; ++first){
+			this->readSymbols.push_back(static_cast<uint8_t>(first->toIndex()));
+		}
+
+		if(this->readSymbols.size() < this->k){
+			return 0;
+		}
+
+		this->minimizerHashes.clear();
+		this->minimizerRoller.reset();
+		for(const uint8_t symbol : this->readSymbols){
+			this->minimizerRoller.push(symbol);
+
+			if(this->minimizerRoller.ready()){
+				const size_t code = this->canonical ? this->minimizerRoller.canonical() : this->minimizerRoller.forward();
+				this->minimizerHashes.push_back(HLDSMinimizerBucketer::hash(code));
+			}
+		}
+
+		const size_t window = this->k - this->minimizerSize + 1;
+		const size_t kmers = this->readSymbols.size() - this->k + 1;
+		const std::vector<uint64_t> &hashes = this->minimizerHashes;
+
+		size_t minimizer = std::min_element(hashes.cbegin(), hashes.cbegin() + window) - hashes.cbegin();
+		size_t superKmerStart = 0;
+
+		for(size_t kmer = 1; kmer < kmers; ++kmer){
+			size_t next = minimizer;
+
+			if(minimizer < kmer){
+				next = std::min_element(hashes.cbegin() + kmer, hashes.cbegin() + kmer + window) - hashes.cbegin();
+			}
+			else if(hashes[kmer + window - 1] < hashes[minimizer]){
+				next = kmer + window - 1;
+			}
+
+			if(next != minimizer){
+				this->emit(superKmerStart, kmer - 1, hashes[minimizer]);
+				superKmerStart = kmer;
+				minimizer = next;
+			}
+		}
+
+		this->emit(superKmerStart, kmers - 1, hashes[minimizer]);
+
+		return kmers;
+	}
+
+	size_t addRead(const Key &read){
+		return this->addRead(read.cbegin(), read.cend());
+	}
+
+	// counts all buffered k-mers into the storage, bucket by bucket, and empties the buckets
+	void flush(){
+		if(this->threadCount > 1 && this->hlds.getPager() != nullptr){
+			throw std::logic_error("Parallel flush requires paging to be off");
+		}
+
+		std::atomic<size_t> nextBucket(0);
+		std::exception_ptr error;
+		std::mutex errorLock;
+
+		auto worker = [&](){
+			try{
+				KmerCodeRoller<Key> roller(this->kmerRoller);
+				std::vector<size_t> codes;
+
+				for(size_t i = nextBucket++; i < this->buckets.size(); i = nextBucket++){
+					this->countBucket(this->buckets[i], roller, codes);
+				}
+			}
+			catch(...){
+				std::lock_guard<std::mutex> guard(errorLock);
+				error = std::current_exception();
+			}
+		};
+
+		if(this->threadCount == 1){
+			worker();
+		}
+		else{
+			std::vector<std::thread> threads;
+			for(size_t i = 0; i < this->threadCount; ++i){
+				threads.emplace_back(worker);
+			}
+
+			for(std::thread &thread : threads){
+				thread.join();
+			}
+		}
+
+		for(Bucket &bucket : this->buckets){
+			bucket.symbols.clear();
+			bucket.ends.clear();
+		}
+
+		this->kmerCount += this->bufferedKmers;
+		this->bufferedKmers = 0;
+
+		if(error){
+			std::rethrow_exception(error);
+		}
+	}
+
+	// k-mers added but not flushed yet
+	size_t getBufferedKmerCount() const{
+		return this->bufferedKmers;
+	}
+
+	// k-mers flushed so far
+	size_t getKmerCount() const{
+		return this->kmerCount;
+	}
+
+	size_t getSuperKmerCount() const{
+		return this->superKmerCount;
+	}
+};
+
+template<typename Key, typename Value>
+constexpr size_t HLDSMinimizerBucketer<Key, Value>::headsPerLock;
+
+template<typename Key, typename Value>
+constexpr size_t HLDSMinimizerBucketer<Key, Value>::lockCount;
+
+#endif // HLDSMINIMIZERBUCKETER_HPP
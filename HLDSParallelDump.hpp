@@ -0,0 +1,268 @@
+#ifndef HLDSPARALLELDUMP_HPP
+#define HLDSPARALLELDUMP_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "HLDSDump.hpp"
+#include "HLDSBufferedDumpWriter.hpp"
+#include "WorkStealingScheduler.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include <unistd.h>
+
+// heads [firstHead, endHead) of a dump, recordCount records from offset on in their file
+struct HLDSDumpRange{
+	uint64_t firstHead;
+	uint64_t endHead;
+	uint64_t offset;
+	uint64_t recordCount;
+};
+
+/*
+ * Describes a dump split into ranges of heads, written next to the dump as
+ * <path>.manifest. Ranges are contiguous, in key order and cover all heads.
+ *
+ * A segmented dump keeps range i in <path>.<i>, a complete dump of its own
+ * (header and records) readable by HLDSDumpReader. A single file dump is <path>,
+ * byte for byte what HLDSDumpWriter::dumpAll() writes, with ranges at offsets.
+ */
+struct HLDSDumpManifest{
+	static constexpr uint64_t magic = 0x314E414D53444C48ULL; // "HLDSMAN1"
+
+	uint64_t hldsId = 0;
+	uint64_t keySize = 0;
+	uint64_t headSize = 0;
+	bool singleFile = false;
+	std::vector<HLDSDumpRange> ranges;
+
+	static std::string manifestPath(const std::string &path){
+		return path + ".manifest";
+	}
+
+	static std::string segmentPath(const std::string &path, const size_t range){
+		return path + "." + std::to_string(range);
+	}
+
+	// file holding the records of range
+	std::string rangePath(const std::string &path, const size_t range) const{
+		return this->singleFile ? path : HLDSDumpManifest::segmentPath(path, range);
+	}
+
+	uint64_t recordCount() const{
+		uint64_t result = 0;
+		for(const HLDSDumpRange &range : this->ranges){
+			result += range.recordCount;
+		}
+
+		return result;
+	}
+
+	void toStream(std::ostream &o) const{
+		writeBinary<uint64_t>(uint64_t(magic), o);
+		writeBinary<uint64_t>(this->hldsId, o);
+		writeBinary<uint64_t>(this->keySize, o);
+		writeBinary<uint64_t>(this->headSize, o);
+		writeBinary<uint64_t>(this->singleFile ? 1 : 0, o);
+		writeBinary<uint64_t>(this->ranges.size(), o);
+
+		for(const HLDSDumpRange &range : this->ranges){
+			writeBinary<HLDSDumpRange>(range, o);
+		}
+	}
+
+	static HLDSDumpManifest fromStream(std::istream &i){
+		if(readBinary<uint64_t>(i) != magic){
+			throw std::runtime_error("Not a dump manifest");
+		}
+
+		HLDSDumpManifest manifest;
+		manifest.hldsId = readBinary<uint64_t>(i);
+		manifest.keySize = readBinary<uint64_t>(i);
+		manifest.headSize = readBinary<uint64_t>(i);
+		manifest.singleFile = readBinary<uint64_t>(i) != 0;
+
+		manifest.ranges.resize(readBinary<uint64_t>(i));
+		for(HLDSDumpRange &range : manifest.ranges){
+			range = readBinary<HLDSDumpRange>(i);
+		}
+
+		return manifest;
+	}
+
+	// reads the manifest of the dump at path
+	static HLDSDumpManifest read(const std::string &path){
+		std::ifstream manifest(HLDSDumpManifest::manifestPath(path), std::ios_base::binary);
+		if(manifest.is_open() == false){
+			throw std::runtime_error("No dump manifest for " + path);
+		}
+
+		manifest.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+		return HLDSDumpManifest::fromStream(manifest);
+	}
+};
+
+/*
+ * Dumps a HybridLargeDataStorage on several threads. Heads are split into
+ * contiguous ranges holding about the same number of keys (counted first),
+ * each range is encoded by one thread into its own file or, since records
+ * have a fixed size, at its precomputed offset of one shared file.
+ * Ranges are handed out by work stealing, more ranges than threads even out
+ * the encoding speed of the threads, each range is written through its own
+ * HLDSBufferedDumpWriter. The storage must not change meanwhile.
+ */
+template<typename Key, typename Value>
+class HLDSParallelDumpWriter{
+	const HybridLargeDataStorage<Key, Value> &hlds;
+	const size_t threadCount;
+	const size_t rangeCount;
+
+	const size_t recordSize;
+
+	HLDSDumpManifest plan(const bool singleFile) const{
+		HLDSDumpManifest manifest;
+		manifest.hldsId = this->hlds.getId();
+		manifest.keySize = this->hlds.keySize();
+		manifest.headSize = this->hlds.getHeadSize();
+		manifest.singleFile = singleFile;
+
+		const size_t headCount = this->hlds.getHeadCount();
+		std::vector<uint64_t> headItems(headCount);
+
+		WorkStealingScheduler(this->threadCount).run(headCount, [&](const size_t, const size_t begin, const size_t end){
+			for(size_t head = begin; head < end; ++head){
+				headItems[head] = this->hlds.getHeadItemCount(head);
+			}
+		});
+
+		uint64_t total = 0;
+		for(const uint64_t items : headItems){
+			total += items;
+		}
+
+		// range i ends at the first head boundary reaching (i + 1) / rangeCount of the keys
+		uint64_t offset = HLDSDumpHeader::serializedSize();
+		uint64_t done = 0;
+		size_t head = 0;
+
+		for(size_t i = 0; i < this->rangeCount; ++i){
+			HLDSDumpRange range = {head, head, offset, 0};
+			const uint64_t target = total * (i + 1) / this->rangeCount;
+
+			while(head < headCount && (done < target || i + 1 == this->rangeCount)){
+				done += headItems[head];
+				range.recordCount += headItems[head];
+				++head;
+			}
+
+			range.endHead = head;
+			manifest.ranges.push_back(range);
+
+			if(singleFile){
+				offset += range.recordCount * this->recordSize;
+			}
+		}
+
+		return manifest;
+	}
+
+	static constexpr size_t rangeBufferSize = 1 << 20;
+
+	void writeRange(HLDSBufferedDumpWriter<Key, Value> &writer, const HLDSDumpRange &range) const{
+		uint64_t written = 0;
+
+		this->hlds.forEachInHeads(range.firstHead, range.endHead, [&](const Key &key, const Value &value){
+			writer.write(key, value);
+			++written;
+		});
+
+		writer.close();
+
+		if(written != range.recordCount){
+			throw std::logic_error("Storage was modified during the dump");
+		}
+	}
+
+	void writeManifest(const std::string &path, const HLDSDumpManifest &manifest) const{
+		std::ofstream out(HLDSDumpManifest::manifestPath(path), std::ios_base::binary | std::ios_base::trunc);
+		out.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+		manifest.toStream(out);
+	}
+
+public:
+	// rangeCount 0 picks 4 ranges per thread
+	HLDSParallelDumpWriter(const HybridLargeDataStorage<Key, Value> &hlds, const size_t threadCount, const size_t rangeCount = 0):
+		hlds(hlds),
+		threadCount(threadCount),
+		rangeCount(rangeCount != 0 ? rangeCount : threadCount * 4),
+		recordSize(HLDSDumpRecord<Key, Value>::serializedSize(hlds.keySize()))
+	{
+		if(threadCount == 0){
+			throw std::invalid_argument("threadCount must be positive");
+		}
+
+		if(threadCount > 1 && hlds.getPager() != nullptr){
+			throw std::logic_error("Parallel dump requires paging to be off");
+		}
+	}
+
+	// writes range i to <path>.i and the manifest to <path>.manifest
+	HLDSDumpManifest dumpSegments(const std::string &path) const{
+		const HLDSDumpManifest manifest = this->plan(false);
+		const HLDSDumpHeader header(manifest.hldsId, manifest.keySize);
+
+		WorkStealingScheduler(this->threadCount, 1).run(manifest.ranges.size(), [&](const size_t, const size_t range, const size_t){
+			std::ofstream out(HLDSDumpManifest::segmentPath(path, range), std::ios_base::binary | std::ios_base::trunc);
+			out.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+			HLDSBufferedDumpWriter<Key, Value> writer(out, rangeBufferSize);
+			writer.writeHeader(header);
+			this->writeRange(writer, manifest.ranges[range]);
+		});
+
+		this->writeManifest(path, manifest);
+		return manifest;
+	}
+
+	// writes the dump to path, every range through its own stream, and the manifest to <path>.manifest
+	HLDSDumpManifest dumpSingleFile(const std::string &path) const{
+		const HLDSDumpManifest manifest = this->plan(true);
+
+		{
+			std::ofstream out(path, std::ios_base::binary | std::ios_base::trunc);
+			out.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+			HLDSDumpHeader(manifest.hldsId, manifest.keySize).toStream(out);
+		}
+
+		const uint64_t size = HLDSDumpHeader::serializedSize() + manifest.recordCount() * this->recordSize;
+		if(::truncate(path.c_str(), static_cast<off_t>(size)) != 0){
+			throw std::runtime_error("Can't resize " + path + ": " + std::strerror(errno));
+		}
+
+		WorkStealingScheduler(this->threadCount, 1).run(manifest.ranges.size(), [&](const size_t, const size_t range, const size_t){
+			std::fstream out(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			out.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+			out.seekp(manifest.ranges[range].offset);
+
+			HLDSBufferedDumpWriter<Key, Value> writer(out, rangeBufferSize);
+			this->writeRange(writer, manifest.ranges[range]);
+		});
+
+		this->writeManifest(path, manifest);
+		return manifest;
+	}
+};
+
+template<typename Key, typename Value>
+constexpr size_t HLDSParallelDumpWriter<Key, Value>::rangeBufferSize;
+
+#endif // HLDSPARALLELDUMP_HPP
@@ -0,0 +1,216 @@
+#ifndef HLDSPREFETCHINGDUMPREADER_HPP
+#define HLDSPREFETCHINGDUMPREADER_HPP
+
+#include "HLDSDump.hpp"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <condition_variable>
+
+/*
+ * Drop-in for HLDSDumpReader (use it as the Reader of the mergers) that reads
+ * ahead: a background thread fills up to depth blocks of about bufferSize bytes
+ * with large sequential reads while records are decoded from the oldest one,
+ * so interleaved readers of several dumps don't turn into small seeks.
+ * Blocks hold whole records, decoding goes through HLDSDumpRecord::decode().
+ *
+ * src must not be used by anyone else until the reader is destroyed. Errors of
+ * src are rethrown by read() once the records read before them are consumed.
+ */
+template<typename Key, typename Value>
+class HLDSPrefetchingDumpReader{
+	struct Block{
+		std::unique_ptr<char[]> data;
+		size_t size = 0;
+	};
+
+	std::istream &src;
+	HLDSDumpHeader header;
+	size_t recordSize = 0;
+	size_t blockSize = 0;
+
+	std::vector<Block> blocks; // ring of depth blocks
+	size_t produced = 0;	// blocks filled by the background thread
+	size_t consumed = 0;	// blocks released by the reader
+	bool exhausted = false;	// src has no more data
+	bool stopping = false;
+	std::exception_ptr error;
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread background;
+
+	const Block *current = nullptr;
+	size_t position = 0; // in current
+
+	HLDSDumpRecord<Key, Value> buffer;
+	bool alive = true;
+
+	void run(){
+		std::unique_lock<std::mutex> guard(this->lock);
+
+		while(true){
+			this->changed.wait(guard, [this](){
+				return this->stopping || this->produced - this->consumed < this->blocks.size();
+			});
+
+			if(this->stopping){
+				return;
+			}
+
+			Block &block = this->blocks[this->produced % this->blocks.size()];
+			guard.unlock();
+
+			std::exception_ptr failure;
+			try{
+				this->src.read(block.data.get(), this->blockSize);
+				block.size = static_cast<size_t>(this->src.gcount());
+			}
+			catch(...){
+				failure = std::current_exception();
+				block.size = 0;
+			}
+
+			guard.lock();
+			this->error = failure;
+			this->exhausted = failure || block.size < this->blockSize;
+
+			if(block.size != 0){
+				++this->produced;
+			}
+
+			this->changed.notify_all();
+
+			if(this->exhausted){
+				return;
+			}
+		}
+	}
+
+	// moves to the next filled block, false at the end of src
+	bool nextBlock(){
+		std::unique_lock<std::mutex> guard(this->lock);
+
+		if(this->current != nullptr){
+			this->current = nullptr;
+			++this->consumed;
+			this->changed.notify_all();
+		}
+
+		this->changed.wait(guard, [this](){
+			return this->produced > this->consumed || this->exhausted;
+		});
+
+		if(this->produced == this->consumed){
+			if(this->error){
+				std::exception_ptr error = this->error;
+				this->error = nullptr;
+				std::rethrow_exception(error);
+			}
+
+			return false;
+		}
+
+		this->current = &this->blocks[this->consumed % this->blocks.size()];
+		this->position = 0;
+
+		return true;
+	}
+
+	void readRecord(){
+		if(this->current == nullptr || this->current->size - this->position < this->recordSize){
+			if(this->nextBlock() == false || this->current->size < this->recordSize){
+				this->alive = false; // a truncated last record ends the dump like in HLDSDumpReader
+				return;
+			}
+		}
+
+		this->buffer = HLDSDumpRecord<Key, Value>::decode(this->current->data.get() + this->position, this->header.keySize);
+		this->position += this->recordSize;
+	}
+
+	void stop(){
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->stopping = true;
+			this->changed.notify_all();
+		}
+
+		if(this->background.joinable()){
+			this->background.join();
+		}
+	}
+
+public:
+	// depth blocks of about bufferSize bytes each are kept in flight
+	HLDSPrefetchingDumpReader(std::istream &src, const size_t bufferSize = 4 << 20, const size_t depth = 2): src(src){
+		if(depth == 0){
+			throw std::invalid_argument("depth must be positive");
+		}
+
+		this->src.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+		this->header = HLDSDumpHeader::fromStream(this->src);
+
+		// a short read at the end of src is not an error, a failing device still is
+		this->src.exceptions(std::ios_base::badbit);
+
+		this->recordSize = HLDSDumpRecord<Key, Value>::serializedSize(this->header.keySize);
+		this->blockSize = std::max(bufferSize / this->recordSize, size_t(1)) * this->recordSize;
+
+		this->blocks.resize(depth);
+		for(Block &block : this->blocks){
+			block.data.reset(new char[this->blockSize]);
+		}
+
+		this->background = std::thread(&HLDSPrefetchingDumpReader::run, this);
+
+		try{
+			this->readRecord();
+		}
+		catch(...){
+			this->stop();
+			throw;
+		}
+	}
+
+	HLDSPrefetchingDumpReader(const HLDSPrefetchingDumpReader &) = delete;
+	HLDSPrefetchingDumpReader &operator=(const HLDSPrefetchingDumpReader &) = delete;
+
+	~HLDSPrefetchingDumpReader(){
+		this->stop();
+	}
+
+	const HLDSDumpHeader &getHeader() const{
+		return this->header;
+	}
+
+	bool hasNext() const{
+		return this->alive;
+	}
+
+	HLDSDumpRecord<Key, Value> read(){
+		if(this->alive == false){
+			throw std::underflow_error("Stream is dead");
+		}
+
+		HLDSDumpRecord<Key, Value> result = std::move(this->buffer);
+		this->readRecord();
+		return result;
+	}
+
+	const HLDSDumpRecord<Key, Value> &peek() const{
+		if(this->alive == false){
+			throw std::underflow_error("Stream is dead");
+		}
+
+		return this->buffer;
+	}
+};
+
+#endif // HLDSPREFETCHINGDUMPREADER_HPP
@@ -0,0 +1,194 @@
+#ifndef HLDSREDUCERS_HPP
+#define HLDSREDUCERS_HPP
+
+#include <array>
+#include <bitset>
+#include <limits>
+#include <cassert>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+/*
+ * Reducer interface used by the dump mergers:
+ *
+ *	typedef ... InValue;	// value type of the source dumps
+ *	typedef ... OutValue;	// value type of the resulting dump
+ *
+ *	OutValue identity() const;
+ *	void accumulate(OutValue &accumulator, const size_t source, const InValue &value) const;
+ *	bool accept(const OutValue &accumulator) const; // false drops the record
+ *
+ * For every key the merger starts from identity() and calls accumulate()
+ * once per source that contains the key, passing the source index.
+ */
+
+template<typename T, size_t sampleCount>
+using SampleVector = std::array<T, sampleCount>;
+
+template<size_t sampleCount>
+using SampleBitmap = std::bitset<sampleCount>;
+
+
+template<typename Value>
+class SumReducer{
+public:
+	typedef Value InValue;
+	typedef Value OutValue;
+
+	OutValue identity() const{
+		return OutValue();
+	}
+
+	void accumulate(OutValue &accumulator, const size_t, const InValue &value) const{
+		accumulator += value;
+	}
+
+	bool accept(const OutValue &) const{
+		return true;
+	}
+};
+
+template<typename Value>
+class MaxReducer{
+public:
+	typedef Value InValue;
+	typedef Value OutValue;
+
+	OutValue identity() const{
+		return std::numeric_limits<OutValue>::min();
+	}
+
+	void accumulate(OutValue &accumulator, const size_t, const InValue &value) const{
+		accumulator = std::max(accumulator, value);
+	}
+
+	bool accept(const OutValue &) const{
+		return true;
+	}
+};
+
+template<typename Value>
+class MinReducer{
+public:
+	typedef Value InValue;
+	typedef Value OutValue;
+
+	OutValue identity() const{
+		return std::numeric_limits<OutValue>::max();
+	}
+
+	void accumulate(OutValue &accumulator, const size_t, const InValue &value) const{
+		accumulator = std::min(accumulator, value);
+	}
+
+	bool accept(const OutValue &) const{
+		return true;
+	}
+};
+
+// Sums only the values reaching the threshold, keys with nothing left are dropped
+template<typename Value>
+class ThresholdedSumReducer{
+	Value threshold;
+
+public:
+	typedef Value InValue;
+	typedef Value OutValue;
+
+	ThresholdedSumReducer(const Value threshold): threshold(threshold){}
+
+	OutValue identity() const{
+		return OutValue();
+	}
+
+	void accumulate(OutValue &accumulator, const size_t, const InValue &value) const{
+		if(value >= this->threshold){
+			accumulator += value;
+		}
+	}
+
+	bool accept(const OutValue &accumulator) const{
+		return accumulator != OutValue();
+	}
+};
+
+// Per-sample counts: source index N goes to the N-th slot, saturating at the Counter range
+template<typename Value, typename Counter, size_t sampleCount>
+class SampleCountReducer{
+public:
+	typedef Value InValue;
+	typedef SampleVector<Counter, sampleCount> OutValue;
+
+	OutValue identity() const{
+		OutValue result;
+		result.fill(Counter());
+		return result;
+	}
+
+	void accumulate(OutValue &accumulator, const size_t source, const InValue &value) const{
+		assert(source < sampleCount);
+
+		constexpr Counter counterMax = std::numeric_limits<Counter>::max();
+		const Counter current = accumulator.at(source);
+
+		if(value >= static_cast<InValue>(counterMax - current)){
+			accumulator.at(source) = counterMax;
+		}
+		else{
+			accumulator.at(source) = current + static_cast<Counter>(value);
+		}
+	}
+
+	bool accept(const OutValue &) const{
+		return true;
+	}
+};
+
+// Per-sample presence: the N-th bit is set if source N has the key with at least `threshold` occurrences
+template<typename Value, size_t sampleCount>
+class SamplePresenceReducer{
+	Value threshold;
+
+public:
+	typedef Value InValue;
+	typedef SampleBitmap<sampleCount> OutValue;
+
+	SamplePresenceReducer(const Value threshold = 1): threshold(threshold){}
+
+	OutValue identity() const{
+		return OutValue();
+	}
+
+	void accumulate(OutValue &accumulator, const size_t source, const InValue &value) const{
+		assert(source < sampleCount);
+
+		if(value >= this->threshold){
+			accumulator.set(source);
+		}
+	}
+
+	bool accept(const OutValue &accumulator) const{
+		return accumulator.any();
+	}
+};
+
+/*
+ * True for reducers that give a key found in one source only its own value
+ * back and accept it, so HybridLargeDataStorage::merge() leaves such keys
+ * as they are instead of running each of them through the reducer.
+ */
+template<typename Reducer>
+struct KeepsSingleValues : std::false_type{};
+
+template<typename Value>
+struct KeepsSingleValues<SumReducer<Value>> : std::true_type{};
+
+// numeric_limits<>::min() is no identity of max() for floating point values
+template<typename Value>
+struct KeepsSingleValues<MaxReducer<Value>> : std::is_integral<Value>{};
+
+template<typename Value>
+struct KeepsSingleValues<MinReducer<Value>> : std::is_integral<Value>{};
+
+#endif // HLDSREDUCERS_HPP
@@ -10,7 +10,7 @@
 #include <vector>
 #include <functional>
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool isConst>
 class HeadsIterator;
 
 template<typename Key, typename Value>
@@ -21,9 +21,12 @@ class HeadsHolder : protected HeadsContainer<Key, Value>{
 	const size_t headKeyLength;
 	const size_t tailKeyLength;
 
+	std::vector<bool> dirty; // heads handed out for modification since the last clearDirty()
+
 public:
 
-	typedef HeadsIterator<Key, Value> iterator;
+	typedef HeadsIterator<Key, Value, false> iterator;
+	typedef HeadsIterator<Key, Value, true> const_iterator;
 	typedef typename HeadsContainer<Key, Value>::value_type value_type;
 
 
@@ -44,23 +47,28 @@ public:
 
 		HeadsContainer<Key, Value> &base = *this;
 		base.resize(headCount, emptyTailTree);
+
+		this->dirty.assign(headCount, false);
 	}
 
 	HeadsHolder(const HeadsHolder &o):
 		HeadsContainer<Key, Value>(o),
 		headKeyLength(o.headKeyLength),
-		tailKeyLength(o.tailKeyLength){}
+		tailKeyLength(o.tailKeyLength),
+		dirty(o.dirty){}
 
 	HeadsHolder(HeadsHolder &&o):
 		HeadsContainer<Key, Value>(std::move(o)),
 		headKeyLength(o.headKeyLength),
-		tailKeyLength(o.tailKeyLength){}
+		tailKeyLength(o.tailKeyLength),
+		dirty(std::move(o.dirty)){}
 
 	HeadsHolder &operator=(HeadsHolder o){
 		assert(this->headKeyLength == o.headKeyLength);
 		assert(this->tailKeyLength == o.tailKeyLength);
 
 		this->HeadsContainer<Key, Value>::operator=(std::move(o));
+		this->dirty = std::move(o.dirty);
 
 		return *this;
 	}
@@ -69,12 +77,64 @@ public:
 		for(TailTree<Key, Value> &tailTree : *this){
 			tailTree.clear();
 		}
+
+		this->dirty.assign(this->dirty.size(), true);
+	}
+
+	value_type &head(const size_t index){
+		return this->HeadsContainer<Key, Value>::at(index);
+	}
+
+	const value_type &head(const size_t index) const{
+		return this->HeadsContainer<Key, Value>::at(index);
+	}
+
+	void markDirty(const size_t index){
+		this->dirty[index] = true;
+	}
+
+	bool isDirty(const size_t index) const{
+		return this->dirty[index];
+	}
+
+	void clearDirty(){
+		this->dirty.assign(this->dirty.size(), false);
 	}
 
 	size_t size() const{
 		return this->HeadsContainer<Key, Value>::size();
 	}
 
+	// points all tail trees to the factories of the storage this holder was moved into
+	void rebind(
+		const CountingFactory<Node<Key, Value>> &nodeFactory,
+		const CountingFactory<ValueNode<Key, Value>> &valueNodeFactory,
+		HeadsPager<Key, Value> *pager
+	){
+		HeadsContainer<Key, Value> &base = *this;
+
+		for(TailTree<Key, Value> &tailTree : base){
+			tailTree.nodeFactory = &nodeFactory;
+			tailTree.valueNodeFactory = &valueNodeFactory;
+		}
+
+		if(pager != nullptr){
+			pager->rebind(nodeFactory, valueNodeFactory, base.data());
+		}
+	}
+
+	void attachPager(HeadsPager<Key, Value> *pager){
+		HeadsContainer<Key, Value> &base = *this;
+
+		for(TailTree<Key, Value> &tailTree : base){
+			tailTree.pager = pager;
+		}
+
+		if(pager != nullptr){
+			pager->attach(base.data(), base.size());
+		}
+	}
+
 	iterator begin(){
 		Key headKey = Key::fromIndex(0, this->headKeyLength);
 
@@ -84,17 +144,32 @@ public:
 		return iterator(it, headKey);
 	}
 
-	iterator end()/* const*/{
+	const_iterator cbegin() const{
+		const HeadsContainer<Key, Value> &base = *this;
+		return const_iterator(base.cbegin(), Key::fromIndex(0, this->headKeyLength));
+	}
+
+	iterator end(){
 		HeadsContainer<Key, Value> &base = *this;
 		typename HeadsContainer<Key, Value>::iterator it = base.end();
 
 		return iterator(it, Key());
 	}
 
+	const_iterator end() const{
+		return this->cend();
+	}
+
+	const_iterator cend() const{
+		const HeadsContainer<Key, Value> &base = *this;
+		return const_iterator(base.cend(), Key());
+	}
+
 	iterator find(Key headKey){
 		assert(headKey.size() == this->headKeyLength);
 
 		const size_t index = headKey.toIndex();
+		this->dirty[index] = true;
 
 		HeadsContainer<Key, Value> &base = *this;
 		typename HeadsContainer<Key, Value>::iterator it = base.begin() + index;
@@ -102,6 +177,16 @@ public:
 		return iterator(it, std::move(headKey));
 	}
 
+	// find() leaving the head clean
+	const_iterator find(Key headKey) const{
+		assert(headKey.size() == this->headKeyLength);
+
+		const HeadsContainer<Key, Value> &base = *this;
+		typename HeadsContainer<Key, Value>::const_iterator it = base.cbegin() + headKey.toIndex();
+
+		return const_iterator(it, std::move(headKey));
+	}
+
 	iterator first_not_empty(){
 		HeadsContainer<Key, Value> &base = *this;
 
@@ -117,6 +202,22 @@ public:
 
 		return iterator(std::move(res), Key::fromIndex(index, this->headKeyLength));
 	}
+
+	const_iterator first_not_empty() const{
+		const HeadsContainer<Key, Value> &base = *this;
+
+		auto res = std::find_if(base.cbegin(), base.cend(), [](const typename HeadsContainer<Key, Value>::value_type &value){
+			return value.isEmpty() == false;
+		});
+
+		if(res == base.cend()){
+			return this->cend();
+		}
+
+		const size_t index = res - base.cbegin();
+
+		return const_iterator(std::move(res), Key::fromIndex(index, this->headKeyLength));
+	}
 };
 
 #endif // HEADSHOLDER_HPP
@@ -4,39 +4,51 @@
 #include "HybridLargeDataStorage.hpp"
 #include "HeadsHolder.hpp"
 
+#include <type_traits>
+
 template<typename Key, typename Value>
 class HeadsHolder;
 
-template<typename Key, typename Value>
-class HeadsIterator : protected HeadsContainer<Key, Value>::iterator{
+template<typename Key, typename Value, bool isConst>
+using HeadsIteratorBase = typename std::conditional<
+	isConst,
+	typename HeadsContainer<Key, Value>::const_iterator,
+	typename HeadsContainer<Key, Value>::iterator
+>::type;
+
+// iterator over the tail trees of a HeadsHolder, the isConst one hands out const trees only
+template<typename Key, typename Value, bool isConst = false>
+class HeadsIterator : protected HeadsIteratorBase<Key, Value, isConst>{
+	typedef HeadsIteratorBase<Key, Value, isConst> Base;
+
 	Key headsKey;
 
 public:
-	typedef typename HeadsContainer<Key, Value>::iterator::difference_type		difference_type;
-	typedef typename HeadsContainer<Key, Value>::iterator::value_type			value_type;
-	typedef typename HeadsContainer<Key, Value>::iterator::pointer				pointer;
-	typedef typename HeadsContainer<Key, Value>::iterator::reference			reference;
-	typedef typename HeadsContainer<Key, Value>::iterator::iterator_category	iterator_category;
+	typedef typename Base::difference_type		difference_type;
+	typedef typename Base::value_type			value_type;
+	typedef typename Base::pointer				pointer;
+	typedef typename Base::reference			reference;
+	typedef typename Base::iterator_category	iterator_category;
 
 
 	explicit HeadsIterator(){}
 
-	HeadsIterator(typename HeadsContainer<Key, Value>::iterator it, Key headsKey):
-		HeadsContainer<Key, Value>::iterator(std::move(it)),
+	HeadsIterator(Base it, Key headsKey):
+		Base(std::move(it)),
 		headsKey(std::move(headsKey))
 	{
 
 	}
 
 	HeadsIterator(const HeadsIterator &headsIterator):
-		HeadsContainer<Key, Value>::iterator(headsIterator),
+		Base(headsIterator),
 		headsKey(headsIterator.headsKey)
 	{
 
 	}
 
 	HeadsIterator(HeadsIterator &&headsIterator):
-		HeadsContainer<Key, Value>::iterator(headsIterator),
+		Base(headsIterator),
 		headsKey(std::move(headsIterator.headsKey))
 	{
 
@@ -49,7 +61,7 @@ public:
 	HeadsIterator &operator=(HeadsIterator headsIterator){
 		this->headsKey = std::move(headsIterator.headsKey);
 
-		typename HeadsContainer<Key, Value>::iterator &base = *this;
+		Base &base = *this;
 		base = std::move(headsIterator);
 
 		return *this;
@@ -58,7 +70,7 @@ public:
 	HeadsIterator &operator++(){
 		++headsKey;
 
-		typename HeadsContainer<Key, Value>::iterator &base = *this;
+		Base &base = *this;
 		++base;
 
 		return *this;
@@ -68,15 +80,15 @@ public:
 		HeadsIterator result(*this);
 		result.headsKey += distance;
 
-		typename HeadsContainer<Key, Value>::iterator &base = result;
+		Base &base = result;
 		base += distance;
 
 		return result;
 	}
 
 	bool operator==(const HeadsIterator &o) const{
-		const typename HeadsContainer<Key, Value>::iterator &thisRef = *this;
-		const typename HeadsContainer<Key, Value>::iterator &oRef = o;
+		const Base &thisRef = *this;
+		const Base &oRef = o;
 		return thisRef == oRef;
 	}
 
@@ -84,27 +96,26 @@ public:
 		return !(*this == o);
 	}
 
-	typename HeadsHolder<Key, Value>::value_type &operator*(){
-		typename HeadsContainer<Key, Value>::iterator &base = *this;
+	reference operator*(){
+		Base &base = *this;
 		return *base;
 	}
 
 	const typename HeadsHolder<Key, Value>::value_type &operator*() const{
-		const typename HeadsContainer<Key, Value>::iterator &base = *this;
+		const Base &base = *this;
 		return *base;
 	}
 
-	typename HeadsHolder<Key, Value>::value_type *operator->(){
-		typename HeadsContainer<Key, Value>::iterator &base = *this;
+	pointer operator->(){
+		Base &base = *this;
 		return &*base;
 	}
 
 	const typename HeadsHolder<Key, Value>::value_type *operator->() const{
-		const typename HeadsContainer<Key, Value>::iterator &base = *this;
+		const Base &base = *this;
 		return &*base;
 	}
 
 };
 
 #endif // HEADSITERATOR_HPP
-
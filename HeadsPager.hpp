@@ -0,0 +1,275 @@
+#ifndef HEADSPAGER_HPP
+#define HEADSPAGER_HPP
+
+#include "TailTree.hpp"
+#include "CountingFactory.hpp"
+#include "Node.hpp"
+#include "ValueNode.hpp"
+#include "HLDSDump.hpp"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cassert>
+#include <stdexcept>
+
+/*
+ * Keeps the RAM used by tail trees under a budget by paging whole heads out
+ * into a spill file and faulting them back in on access. Victims are chosen
+ * with the CLOCK algorithm over the resident heads.
+ *
+ * Paged out heads are stored as sorted (tail key, value) records in the
+ * HLDSDumpRecord format. Every eviction appends to the spill file, which is
+ * compacted once most of it is stale.
+ *
+ * Any access to a head may evict other heads, so iterators into
+ * a paged storage are only valid until the next access to a different head.
+ */
+template<typename Key, typename Value>
+class HeadsPager{
+	struct HeadState{
+		std::streamoff offset = 0;
+		size_t recordCount = 0;		// non-zero only while the head is paged out
+		bool resident = false;		// head is in the CLOCK ring
+		bool referenced = false;
+	};
+
+	static constexpr size_t compactionThreshold = 64 * 1024 * 1024;
+
+	const std::string spillPath;
+	std::fstream spill;
+	const size_t ramBudget;
+
+	const CountingFactory<Node<Key, Value>> *nodeFactory;
+	const CountingFactory<ValueNode<Key, Value>> *valueNodeFactory;
+
+	TailTree<Key, Value> *heads = nullptr;
+	size_t recordSize = 0;
+
+	std::vector<HeadState> states;
+	std::vector<size_t> ring;
+	size_t hand = 0;
+
+	size_t liveRecords = 0;
+	size_t spilledRecords = 0;
+
+	size_t faultCount = 0;
+	size_t evictionCount = 0;
+
+public:
+	HeadsPager(
+		std::string spillPath,
+		const size_t ramBudget,
+		const CountingFactory<Node<Key, Value>> &nodeFactory,
+		const CountingFactory<ValueNode<Key, Value>> &valueNodeFactory
+	):
+		spillPath(std::move(spillPath)),
+		ramBudget(ramBudget),
+		nodeFactory(&nodeFactory),
+		valueNodeFactory(&valueNodeFactory)
+	{
+		this->openSpill(std::ios_base::trunc);
+	}
+
+	HeadsPager(const HeadsPager &) = delete;
+	HeadsPager &operator=(const HeadsPager &) = delete;
+
+	~HeadsPager(){
+		this->spill.close();
+		std::remove(this->spillPath.c_str());
+	}
+
+	void attach(TailTree<Key, Value> *heads, const size_t headCount){
+		assert(headCount > 0);
+
+		this->heads = heads;
+		this->recordSize = HLDSDumpRecord<Key, Value>::serializedSize(heads->depth - 1);
+		this->states.assign(headCount, HeadState());
+		this->ring.clear();
+		this->hand = 0;
+	}
+
+	// the owning storage was moved: the factories and the heads live elsewhere now
+	void rebind(
+		const CountingFactory<Node<Key, Value>> &nodeFactory,
+		const CountingFactory<ValueNode<Key, Value>> &valueNodeFactory,
+		TailTree<Key, Value> *heads
+	){
+		this->nodeFactory = &nodeFactory;
+		this->valueNodeFactory = &valueNodeFactory;
+		this->heads = heads;
+	}
+
+	// to be called after all the heads were cleared
+	void reset(){
+		this->states.assign(this->states.size(), HeadState());
+		this->ring.clear();
+		this->hand = 0;
+		this->liveRecords = 0;
+		this->spilledRecords = 0;
+
+		this->spill.close();
+		this->openSpill(std::ios_base::trunc);
+	}
+
+	size_t residentSize() const{
+		return
+			this->nodeFactory->producedItemsCount() * sizeof(Node<Key, Value>) +
+			this->valueNodeFactory->producedItemsCount() * sizeof(ValueNode<Key, Value>);
+	}
+
+	size_t getFaultCount() const{
+		return this->faultCount;
+	}
+
+	size_t getEvictionCount() const{
+		return this->evictionCount;
+	}
+
+	void access(const TailTree<Key, Value> &tree){
+		const size_t index = &tree - this->heads;
+		assert(index < this->states.size());
+
+		HeadState &state = this->states[index];
+		state.referenced = true;
+
+		if(state.resident == false){
+			if(tree.paged){
+				this->faultIn(index);
+			}
+
+			state.resident = true;
+			this->ring.push_back(index);
+		}
+
+		while(this->residentSize() > this->ramBudget && this->ring.size() > 1){
+			this->evictOne(index);
+		}
+	}
+
+private:
+	void openSpill(const std::ios_base::openmode extraMode){
+		this->spill.open(this->spillPath, std::ios_base::in | std::ios_base::out | std::ios_base::binary | extraMode);
+		if(this->spill.is_open() == false){
+			throw std::runtime_error("Can't open spill file " + this->spillPath);
+		}
+
+		this->spill.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+	}
+
+	void evictOne(const size_t keep){
+		while(true){
+			if(this->hand >= this->ring.size()){
+				this->hand = 0;
+			}
+
+			const size_t index = this->ring[this->hand];
+			HeadState &state = this->states[index];
+
+			if(index == keep || state.referenced){
+				state.referenced = false;
+				++this->hand;
+				continue;
+			}
+
+			this->evict(index);
+
+			this->ring[this->hand] = this->ring.back();
+			this->ring.pop_back();
+			return;
+		}
+	}
+
+	void evict(const size_t index){
+		TailTree<Key, Value> &tree = this->heads[index];
+		HeadState &state = this->states[index];
+		assert(tree.paged == false);
+
+		state.resident = false;
+
+		if(tree.root == nullptr){
+			return;
+		}
+
+		this->spill.seekp(0, std::ios_base::end);
+		state.offset = this->spill.tellp();
+		state.recordCount = 0;
+
+		for(auto it = tree.first(); it != tree.end(); ++it){
+			HLDSDumpRecord<Key, Value>(it.getKey(), *it).toStream(this->spill);
+			++state.recordCount;
+		}
+
+		size_t nodes = 0;
+		size_t valueNodes = 0;
+		TailTree<Key, Value>::countNodes(tree.root, nodes, valueNodes);
+
+		tree.clear();
+		tree.paged = true;
+
+		this->nodeFactory->release(nodes);
+		this->valueNodeFactory->release(valueNodes);
+
+		this->liveRecords += state.recordCount;
+		this->spilledRecords += state.recordCount;
+		++this->evictionCount;
+
+		this->compactIfNeeded();
+	}
+
+	void faultIn(const size_t index){
+		TailTree<Key, Value> &tree = this->heads[index];
+		HeadState &state = this->states[index];
+		assert(tree.paged);
+
+		tree.paged = false;
+
+		this->spill.seekg(state.offset);
+		for(size_t i = 0; i < state.recordCount; ++i){
+			HLDSDumpRecord<Key, Value> record = HLDSDumpRecord<Key, Value>::fromStream(this->spill, tree.depth - 1);
+			tree.insert(record.key, std::move(record.value));
+		}
+
+		this->liveRecords -= state.recordCount;
+		state.recordCount = 0;
+		++this->faultCount;
+	}
+
+	void compactIfNeeded(){
+		if(this->spilledRecords * this->recordSize < HeadsPager::compactionThreshold || this->spilledRecords < this->liveRecords * 2){
+			return;
+		}
+
+		const std::string compactedPath = this->spillPath + ".compact";
+		std::ofstream compacted(compactedPath, std::ios_base::binary | std::ios_base::trunc);
+		compacted.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+		std::vector<char> buffer;
+		for(HeadState &state : this->states){
+			if(state.recordCount == 0){
+				continue;
+			}
+
+			buffer.resize(state.recordCount * this->recordSize);
+
+			this->spill.seekg(state.offset);
+			this->spill.read(buffer.data(), buffer.size());
+
+			state.offset = compacted.tellp();
+			compacted.write(buffer.data(), buffer.size());
+		}
+
+		compacted.close();
+		this->spill.close();
+
+		if(std::rename(compactedPath.c_str(), this->spillPath.c_str()) != 0){
+			throw std::runtime_error("Can't replace spill file " + this->spillPath);
+		}
+
+		this->openSpill(std::ios_base::openmode());
+		this->spilledRecords = this->liveRecords;
+	}
+};
+
+#endif // HEADSPAGER_HPP
@@ -7,10 +7,18 @@
 #include "TailTree.hpp"
 #include "HLDSIterator.hpp"
 #include "HeadsHolder.hpp"
+#include "HeadsPager.hpp"
+#include "FrozenHybridLargeDataStorage.hpp"
 #include "CountingFactory.hpp"
+#include "HLDSReducers.hpp"
+#include "WorkStealingScheduler.hpp"
 
 #include <utility>
 #include <vector>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <cstdint>
 #include <cassert>
 #include <cstddef>
 #include <algorithm>
@@ -21,25 +29,58 @@
 template<typename Key, typename Value>
 class TailTree;
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool isConst>
 class HLDSIterator;
 
+template<typename Key, typename Value>
+class HLDSCheckpointer;
+
 template<typename Key, typename Value>
 class HybridLargeDataStorage{
 public:
-	typedef HLDSIterator<Key, Value> iterator;
+	typedef HLDSIterator<Key, Value, false> iterator;
+	typedef HLDSIterator<Key, Value, true> const_iterator;
 	
 private:
 	size_t id;
 	size_t headSize;
 	size_t tailSize;
-	size_t itemCount = 0;
+	std::atomic<size_t> itemCount{0}; // updated concurrently by HLDSMinimizerBucketer
 
 	CountingFactory<Node<Key, Value>> nodeFactory;
 	CountingFactory<ValueNode<Key, Value>> valueNodeFactory;
 
 	HeadsHolder<Key, Value> headsHolder;
 
+	std::unique_ptr<HeadsPager<Key, Value>> pager;
+
+	static const HeadsHolder<Key, Value> &copyableHeads(const HybridLargeDataStorage &o){
+		if(o.pager){
+			throw std::logic_error("Can't copy a paged instance");
+		}
+
+		return o.headsHolder;
+	}
+
+	// calls visitor(key, value) for the keys of one head in order, reusing one key
+	template<typename Visitor>
+	void visitHead(const size_t head, Visitor &visitor) const{
+		const TailTree<Key, Value> &tailTree = this->headsHolder.head(head);
+		if(tailTree.isEmpty()){
+			return;
+		}
+
+		Key key = Key::fromIndex(head, this->headSize);
+		key.resize(this->keySize());
+
+		tailTree.forEach(key, visitor);
+	}
+
+	void checkParallelScan(const size_t threadCount) const{
+		if(threadCount > 1 && this->pager){
+			throw std::logic_error("Parallel scan requires paging to be off");
+		}
+	}
 
 	static size_t generateRandomId(){
 		static std::default_random_engine re(std::chrono::system_clock::now().time_since_epoch().count());
@@ -49,6 +90,59 @@ private:
 	}
 
 
+	// calls function(worker, headIndex) for every head, spreading heads over threadCount threads by work stealing
+	template<typename Function>
+	void forEachHeadParallel(const size_t threadCount, Function function) const{
+		WorkStealingScheduler scheduler(std::max(threadCount, size_t(1)));
+
+		scheduler.run(this->headsHolder.size(), [&](const size_t worker, const size_t begin, const size_t end){
+			for(size_t head = begin; head < end; ++head){
+				function(worker, head);
+			}
+		});
+	}
+
+	void checkMergeable(const HybridLargeDataStorage &o, const size_t threadCount) const{
+		if(&o == this){
+			throw std::logic_error("Cannot merge an instance into itself");
+		}
+
+		if(this->headSize != o.headSize || this->tailSize != o.tailSize){
+			throw std::logic_error("Merged instances must have equal head and tail sizes");
+		}
+
+		if(threadCount > 1 && (this->pager || o.pager)){
+			throw std::logic_error("Parallel merge requires paging to be off");
+		}
+	}
+
+	// runs mergeHead(headIndex) -> TailTree::MergeStats for every head, mergeHead skips the ones it leaves alone
+	template<typename MergeHead>
+	void mergeHeads(const size_t threadCount, MergeHead mergeHead){
+		std::vector<uint8_t> modified(this->headsHolder.size(), 0);
+		std::atomic<size_t> added(0);
+		std::atomic<size_t> rejected(0);
+
+		this->forEachHeadParallel(threadCount, [&](const size_t, const size_t head){
+			const typename TailTree<Key, Value>::MergeStats stats = mergeHead(head);
+
+			if(stats.valueNodes != 0 || stats.shared != 0 || stats.singles != 0){
+				modified[head] = 1;
+				added += stats.valueNodes;
+				rejected += stats.rejected;
+			}
+		});
+
+		for(size_t head = 0; head < modified.size(); ++head){
+			if(modified[head] != 0){
+				this->headsHolder.markDirty(head);
+			}
+		}
+
+		this->itemCount += added;
+		this->itemCount -= rejected;
+	}
+
 public:
 	HybridLargeDataStorage(const size_t id, const size_t headSize, const size_t tailSize):
 		id(id),
@@ -61,19 +155,37 @@ public:
 	HybridLargeDataStorage(const size_t headSize, const size_t tailSize):
 		HybridLargeDataStorage(HybridLargeDataStorage::generateRandomId(), headSize, tailSize){}
 
+	/*
+	 * Snapshot of o in O(heads): the tail trees are shared and a head is copied
+	 * by whichever instance modifies it first, so o may keep ingesting on one
+	 * thread while the copy serves const queries on others. Each instance counts
+	 * the shared nodes in its getApproximateRAMUsage(). Paged instances can't be
+	 * copied, their spilled heads belong to the pager.
+	 */
 	HybridLargeDataStorage(const HybridLargeDataStorage &o):
+		id(o.id),
 		headSize(o.headSize),
 		tailSize(o.tailSize),
+		itemCount(o.itemCount.load()),
 		nodeFactory(o.nodeFactory),
 		valueNodeFactory(o.valueNodeFactory),
-		headsHolder(o.headsHolder){}
+		headsHolder(HybridLargeDataStorage::copyableHeads(o))
+	{
+		this->headsHolder.rebind(this->nodeFactory, this->valueNodeFactory, nullptr);
+	}
 
 	HybridLargeDataStorage(HybridLargeDataStorage &&o):
+		id(o.id),
 		headSize(o.headSize),
 		tailSize(o.tailSize),
+		itemCount(o.itemCount.load()),
 		nodeFactory(std::move(o.nodeFactory)),
 		valueNodeFactory(std::move(o.valueNodeFactory)),
-		headsHolder(std::move(o.headsHolder)){}
+		headsHolder(std::move(o.headsHolder)),
+		pager(std::move(o.pager))
+	{
+		this->headsHolder.rebind(this->nodeFactory, this->valueNodeFactory, this->pager.get());
+	}
 
 	~HybridLargeDataStorage(){}
 
@@ -89,14 +201,125 @@ public:
 		this->nodeFactory = std::move(o.nodeFactory);
 		this->valueNodeFactory = std::move(o.valueNodeFactory);
 		this->headsHolder = std::move(o.headsHolder);
+		this->pager = std::move(o.pager);
+		this->itemCount = o.itemCount.load();
+
+		this->headsHolder.rebind(this->nodeFactory, this->valueNodeFactory, this->pager.get());
 
 		return *this;
 	}
 
 	void clear(){
+		this->itemCount = 0;
 		this->nodeFactory.reset();
 		this->valueNodeFactory.reset();
 		this->headsHolder.reset();
+
+		if(this->pager){
+			this->pager->reset();
+		}
+	}
+
+	/*
+	 * Erases the keys for which predicate(key, value) is true and frees their
+	 * nodes right away. Heads are processed by threadCount threads, so the
+	 * predicate must be safe to call concurrently; paging allows one thread only.
+	 * Returns the number of erased keys. Invalidates all iterators.
+	 */
+	template<typename Predicate>
+	size_t eraseIf(Predicate predicate, const size_t threadCount = 1){
+		if(threadCount > 1 && this->pager){
+			throw std::logic_error("Parallel erase requires paging to be off");
+		}
+
+		std::vector<uint8_t> modified(this->headsHolder.size(), 0);
+		std::atomic<size_t> erased(0);
+
+		this->forEachHeadParallel(threadCount, [&](const size_t, const size_t head){
+			TailTree<Key, Value> &tailTree = this->headsHolder.head(head);
+			if(tailTree.isEmpty()){
+				return;
+			}
+
+			const size_t headErased = tailTree.eraseIf(Key::fromIndex(head, this->headSize), predicate);
+			if(headErased != 0){
+				modified[head] = 1;
+				erased += headErased;
+			}
+		});
+
+		for(size_t head = 0; head < modified.size(); ++head){
+			if(modified[head] != 0){
+				this->headsHolder.markDirty(head);
+			}
+		}
+
+		this->itemCount -= erased;
+		return erased;
+	}
+
+	// erases the keys counted less than threshold times
+	size_t pruneBelow(const Value &threshold, const size_t threadCount = 1){
+		return this->eraseIf([&threshold](const Key &, const Value &value){
+			return value < threshold;
+		}, threadCount);
+	}
+
+	/*
+	 * Moves all keys of o into this instance (same head and tail sizes required)
+	 * and leaves o empty. Subtrees missing here are spliced in without copying,
+	 * every key gets reducer's result (this instance is source 0, o is source 1)
+	 * or is erased if it does not accept it, the same keys and values
+	 * HLDSDumpMerger writes for dumps of both. Runs over threadCount threads
+	 * unless either instance pages. Invalidates all iterators of both instances.
+	 */
+	template<typename Reducer = SumReducer<Value>>
+	void merge(HybridLargeDataStorage &&o, const Reducer &reducer = Reducer(), const size_t threadCount = 1){
+		this->checkMergeable(o, threadCount);
+
+		this->mergeHeads(threadCount, [&](const size_t head){
+			TailTree<Key, Value> &source = o.headsHolder.head(head);
+			if(source.isEmpty() && (KeepsSingleValues<Reducer>::value || this->headsHolder.head(head).isEmpty())){
+				return typename TailTree<Key, Value>::MergeStats();
+			}
+
+			return this->headsHolder.head(head).merge(source, reducer);
+		});
+
+		o.clear();
+	}
+
+	// merge() leaving o intact, subtrees missing here are copied
+	template<typename Reducer = SumReducer<Value>>
+	void mergeFrom(const HybridLargeDataStorage &o, const Reducer &reducer = Reducer(), const size_t threadCount = 1){
+		this->checkMergeable(o, threadCount);
+
+		this->mergeHeads(threadCount, [&](const size_t head){
+			const TailTree<Key, Value> &source = o.headsHolder.head(head);
+			if(source.isEmpty() && (KeepsSingleValues<Reducer>::value || this->headsHolder.head(head).isEmpty())){
+				return typename TailTree<Key, Value>::MergeStats();
+			}
+
+			return this->headsHolder.head(head).mergeFrom(source, reducer);
+		});
+	}
+
+	/*
+	 * Keeps tail trees within ramBudget bytes (as counted by getApproximateRAMUsage(),
+	 * minus the heads table) by paging cold heads out to spillPath.
+	 * See HeadsPager for the iterator invalidation rules.
+	 */
+	void enablePaging(const std::string &spillPath, const size_t ramBudget){
+		if(this->pager){
+			throw std::logic_error("Paging is already enabled");
+		}
+
+		this->pager.reset(new HeadsPager<Key, Value>(spillPath, ramBudget, this->nodeFactory, this->valueNodeFactory));
+		this->headsHolder.attachPager(this->pager.get());
+	}
+
+	const HeadsPager<Key, Value> *getPager() const{
+		return this->pager.get();
 	}
 
 	size_t keySize() const{
@@ -107,6 +330,24 @@ public:
 		return this->id;
 	}
 
+	size_t getHeadSize() const{
+		return this->headSize;
+	}
+
+	// alphabetSize^headSize, heads are numbered by Key::toIndex() of the head key
+	size_t getHeadCount() const{
+		return this->headsHolder.size();
+	}
+
+	// keys stored under one head, counted by walking its tail tree
+	size_t getHeadItemCount(const size_t head) const{
+		return this->headsHolder.head(head).size();
+	}
+
+	size_t size() const{
+		return this->itemCount;
+	}
+
 private:
 	std::pair<Key, Key> splitKey(Key key) const{
 		Key tailKey(this->tailSize);
@@ -130,37 +371,216 @@ public:
 		++this->itemCount;
 	}
 
-	iterator find(const Key &key){
+	// inserts the key or adds value to the stored one
+	void accumulate(Key key, const Value &value){
 		assert(key.size() == this->keySize());
 
 		std::pair<Key, Key> splittedKey = this->splitKey(std::move(key));
 
-		const typename HeadsHolder<Key, Value>::iterator headsIterator = this->headsHolder.find(std::move(splittedKey.first));
-		assert(headsIterator != this->headsHolder.end());
+		typename HeadsHolder<Key, Value>::iterator head = this->headsHolder.find(std::move(splittedKey.first));
+		assert(head != this->headsHolder.end());
+
+		if(head->accumulate(splittedKey.second, value)){
+			++this->itemCount;
+		}
+	}
+
+	/*
+	 * accumulate() for the key given by its Key::toIndex(), builds no Key.
+	 * The index must fit size_t, i.e. alphabetSize^keySize - 1 <= SIZE_MAX.
+	 */
+	void accumulateIndex(const size_t index, const Value &value){
+		size_t tailRange = 1;
+		for(size_t i = 0; i < this->tailSize; ++i){
+			tailRange *= Key::value_type::alphabetSize;
+		}
+
+		const size_t head = index / tailRange;
+		this->headsHolder.markDirty(head);
 
-		typename TailTree<Key, Value>::iterator tailIterator = headsIterator->find(std::move(splittedKey.second));
-		typename TailTree<Key, Value>::iterator tailTreeEnd = headsIterator->end();
+		if(this->headsHolder.head(head).accumulateIndex(index % tailRange, value)){
+			++this->itemCount;
+		}
+	}
 
-		return iterator(std::move(headsIterator), this->headsHolder.end(), std::move(tailIterator), std::move(tailTreeEnd));
+	// copy of this instance sharing its nodes, see the copy constructor
+	HybridLargeDataStorage snapshot() const{
+		return *this;
 	}
 
-	iterator begin(){
-		const typename HeadsHolder<Key, Value>::iterator firstNotEmptyHead = this->headsHolder.first_not_empty();
+	// find() for the key given by its Key::toIndex(), nullptr if there is none
+	Value *findValueByIndex(const size_t index){
+		size_t tailRange = 1;
+		for(size_t i = 0; i < this->tailSize; ++i){
+			tailRange *= Key::value_type::alphabetSize;
+		}
+
+		const size_t head = index / tailRange;
+		this->headsHolder.markDirty(head);
+
+		return this->headsHolder.head(head).findIndex(index % tailRange);
+	}
 
-		if(firstNotEmptyHead == this->headsHolder.end()){
-			return this->end();
+	// findValueByIndex() that leaves shared heads shared, safe to call while a copy is modified
+	const Value *findValueByIndex(const size_t index) const{
+		size_t tailRange = 1;
+		for(size_t i = 0; i < this->tailSize; ++i){
+			tailRange *= Key::value_type::alphabetSize;
 		}
 
-		typename TailTree<Key, Value>::iterator tailTreeIterator = firstNotEmptyHead->begin();
-		typename TailTree<Key, Value>::iterator tailTreeEnd = firstNotEmptyHead->end();
+		return this->headsHolder.head(index / tailRange).findIndex(index % tailRange);
+	}
+
+private:
+	// non-const Holder gives iterator, const Holder gives const_iterator
+	template<typename Iterator, typename Holder>
+	static Iterator findIn(Holder &headsHolder, std::pair<Key, Key> splittedKey){
+		auto headsIterator = headsHolder.find(std::move(splittedKey.first));
+		assert(headsIterator != headsHolder.end());
+
+		auto tailIterator = headsIterator->find(std::move(splittedKey.second));
+		auto tailTreeEnd = headsIterator->end();
+
+		return Iterator(std::move(headsIterator), headsHolder.end(), std::move(tailIterator), std::move(tailTreeEnd));
+	}
+
+	template<typename Iterator, typename Holder>
+	static Iterator beginOf(Holder &headsHolder){
+		auto firstNotEmptyHead = headsHolder.first_not_empty();
+
+		if(firstNotEmptyHead == headsHolder.end()){
+			return Iterator();
+		}
+
+		auto tailTreeIterator = firstNotEmptyHead->begin();
+		auto tailTreeEnd = firstNotEmptyHead->end();
+
+		return Iterator(std::move(firstNotEmptyHead), headsHolder.end(), std::move(tailTreeIterator), std::move(tailTreeEnd));
+	}
+
+public:
+	/*
+	 * The non-const accessors mark the head dirty and copy it if it is shared
+	 * with a snapshot, the iterators returned may modify values.
+	 *
+	 * The const ones (find, contains, count, cbegin, ...) modify nothing, so any
+	 * number of threads may call them concurrently as long as no thread modifies
+	 * the instance and paging is off (a paged head is faulted in on access).
+	 * A snapshot may be read this way while its origin keeps ingesting.
+	 */
+	iterator find(const Key &key){
+		assert(key.size() == this->keySize());
+		return HybridLargeDataStorage::findIn<iterator>(this->headsHolder, this->splitKey(key));
+	}
+
+	const_iterator find(const Key &key) const{
+		assert(key.size() == this->keySize());
+		return HybridLargeDataStorage::findIn<const_iterator>(this->headsHolder, this->splitKey(key));
+	}
+
+	bool contains(const Key &key) const{
+		return this->find(key) != this->cend();
+	}
+
+	// 0 or 1 like std::set::count(), the value is *find(key)
+	size_t count(const Key &key) const{
+		return this->contains(key) ? 1 : 0;
+	}
+
+	iterator begin(){
+		return HybridLargeDataStorage::beginOf<iterator>(this->headsHolder);
+	}
 
-		return iterator(std::move(firstNotEmptyHead), this->headsHolder.end(), std::move(tailTreeIterator), std::move(tailTreeEnd));
+	const_iterator begin() const{
+		return this->cbegin();
+	}
+
+	const_iterator cbegin() const{
+		return HybridLargeDataStorage::beginOf<const_iterator>(this->headsHolder);
 	}
 
 	iterator end(){
 		return iterator();
 	}
 
+	const_iterator end() const{
+		return this->cend();
+	}
+
+	const_iterator cend() const{
+		return const_iterator();
+	}
+
+	/*
+	 * Calls visitor(key, value) for every key. Heads are spread over threadCount
+	 * threads by work stealing, keys of a head are visited in order by one
+	 * thread, heads in no particular order, so the visitor must be safe to call
+	 * concurrently. Reads like the const accessors, paging allows one thread only.
+	 */
+	template<typename Visitor>
+	void parallelForEach(Visitor visitor, const size_t threadCount = 1) const{
+		this->checkParallelScan(threadCount);
+
+		this->forEachHeadParallel(threadCount, [&](const size_t, const size_t head){
+			this->visitHead(head, visitor);
+		});
+	}
+
+	// calls visitor(key, value) for the keys of heads [firstHead, endHead) in key order
+	template<typename Visitor>
+	void forEachInHeads(const size_t firstHead, const size_t endHead, Visitor visitor) const{
+		assert(firstHead <= endHead && endHead <= this->headsHolder.size());
+
+		for(size_t head = firstHead; head < endHead; ++head){
+			this->visitHead(head, visitor);
+		}
+	}
+
+	/*
+	 * Returns init combined with map(key, value) of every key, scanning like
+	 * parallelForEach(). Every thread folds its heads into its own accumulator,
+	 * so combine must be associative and commutative, map safe to call concurrently.
+	 */
+	template<typename T, typename Map, typename Combine>
+	T parallelReduce(T init, Map map, Combine combine, const size_t threadCount = 1) const{
+		this->checkParallelScan(threadCount);
+
+		// (has a value, accumulator) per thread, written once per head
+		std::vector<std::pair<bool, T>> accumulators(std::max(threadCount, size_t(1)), std::make_pair(false, init));
+
+		this->forEachHeadParallel(threadCount, [&](const size_t worker, const size_t head){
+			std::pair<bool, T> headAccumulator(false, init);
+
+			auto fold = [&](std::pair<bool, T> &accumulator, T value){
+				accumulator.second = accumulator.first ? combine(std::move(accumulator.second), std::move(value)) : std::move(value);
+				accumulator.first = true;
+			};
+
+			auto visitor = [&](const Key &key, const Value &value){
+				fold(headAccumulator, map(key, value));
+			};
+
+			this->visitHead(head, visitor);
+
+			if(headAccumulator.first){
+				fold(accumulators[worker], std::move(headAccumulator.second));
+			}
+		});
+
+		for(std::pair<bool, T> &accumulator : accumulators){
+			if(accumulator.first){
+				init = combine(std::move(init), std::move(accumulator.second));
+			}
+		}
+
+		return init;
+	}
+
+	// read-only copy with a packed layout, see FrozenHybridLargeDataStorage
+	FrozenHybridLargeDataStorage<Key, Value> freeze() const{
+		return FrozenHybridLargeDataStorage<Key, Value>(*this);
+	}
+
 	typedef size_t NodeCount;
 	typedef size_t ValueNodeCount;
 
@@ -172,17 +592,19 @@ public:
 		return headsHolderSize + nodesSize + valueNodesSize;
 	}
 
-	bool operator==(/*const */HybridLargeDataStorage &o)/*const*/{
+	bool operator==(const HybridLargeDataStorage &o) const{
 		if(this->itemCount != o.itemCount){
 			return false;
 		}
 
-		return std::equal(this->begin(), this->end(), o.begin());
+		return std::equal(this->cbegin(), this->cend(), o.cbegin());
 	}
 
-	bool operator!=(/*const */HybridLargeDataStorage &o)/*const*/{
+	bool operator!=(const HybridLargeDataStorage &o) const{
 		return !(*this == o);
 	}
+
+	friend class HLDSCheckpointer<Key, Value>;
 };
 
 #endif // HYBRIDLARGEDATASTORAGE_HPP
@@ -1,6 +1,7 @@
 TEMPLATE = app
 CONFIG += console
 CONFIG += c++11
+CONFIG += thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
@@ -23,7 +24,34 @@ HEADERS += \
     Key.hpp \
     CountingFactory.hpp \
     HLDSBinaryDumpMerger.hpp \
-    HLDSDump.hpp
+    HLDSDump.hpp \
+    HLDSReducers.hpp \
+    HLDSDumpMerger.hpp \
+    HLDSDumpSetOperations.hpp \
+    HLDSExternalCounter.hpp \
+    HeadsPager.hpp \
+    FrozenHybridLargeDataStorage.hpp \
+    RankSelectBitVector.hpp \
+    PackedArray.hpp \
+    SuccinctHybridLargeDataStorage.hpp \
+    MinimalPerfectHashIndex.hpp \
+    MappedFile.hpp \
+    HLDSCheckpointer.hpp \
+    IndexedNodePool.hpp \
+    IndexedHybridLargeDataStorage.hpp \
+    TwoBitHybridLargeDataStorage.hpp \
+    HLDSCanonicalCounter.hpp \
+    HLDSMinimizerBucketer.hpp \
+    BlockedBloomFilter.hpp \
+    HLDSFilteredCounter.hpp \
+    HyperLogLog.hpp \
+    HLDSLayoutAdvisor.hpp \
+    FixedHybridLargeDataStorage.hpp \
+    NarrowCounterStore.hpp \
+    WorkStealingScheduler.hpp \
+    HLDSBufferedDumpWriter.hpp \
+    HLDSParallelDump.hpp \
+    HLDSPrefetchingDumpReader.hpp
 
 INCLUDEPATH += ./TinyTestFramework/
 INCLUDEPATH -= ./TinyTestFramework/main.cpp
@@ -0,0 +1,93 @@
+#ifndef HYPERLOGLOG_HPP
+#define HYPERLOGLOG_HPP
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+/*
+ * HyperLogLog distinct count sketch over 64-bit items with 2^precision one-byte
+ * registers. The standard error is about 1.04 / sqrt(2^precision), i.e. 0.8%
+ * at the default precision of 14 (16 KB). Small counts use linear counting.
+ */
+class HyperLogLog{
+	size_t precision;
+	std::vector<uint8_t> registers;
+
+	static uint64_t mix(uint64_t item){
+		item ^= item >> 33;
+		item *= 0xff51afd7ed558ccdULL;
+		item ^= item >> 33;
+		item *= 0xc4ceb9fe1a85ec53ULL;
+		item ^= item >> 33;
+
+		return item;
+	}
+
+public:
+	HyperLogLog(const size_t precision = 14): precision(precision){
+		if(precision < 4 || precision > 18){
+			throw std::invalid_argument("precision must be within 4..18");
+		}
+
+		this->registers.assign(size_t(1) << precision, 0);
+	}
+
+	void add(const uint64_t item){
+		const uint64_t hash = HyperLogLog::mix(item);
+		const size_t index = hash >> (64 - this->precision);
+
+		// position of the first set bit in the remaining bits
+		uint64_t rest = hash << this->precision;
+		uint8_t rank = 1;
+		while(rank <= 64 - this->precision && (rest & (uint64_t(1) << 63)) == 0){
+			rest <<= 1;
+			++rank;
+		}
+
+		if(rank > this->registers[index]){
+			this->registers[index] = rank;
+		}
+	}
+
+	double estimate() const{
+		const double m = static_cast<double>(this->registers.size());
+
+		double sum = 0;
+		size_t zeros = 0;
+		for(const uint8_t value : this->registers){
+			sum += std::ldexp(1.0, -static_cast<int>(value));
+			zeros += value == 0 ? 1 : 0;
+		}
+
+		const double alpha = 0.7213 / (1 + 1.079 / m);
+		const double raw = alpha * m * m / sum;
+
+		if(raw <= 2.5 * m && zeros != 0){
+			return m * std::log(m / zeros);
+		}
+
+		return raw;
+	}
+
+	// makes this sketch count the union of both inputs
+	void merge(const HyperLogLog &o){
+		if(this->precision != o.precision){
+			throw std::invalid_argument("HyperLogLog precision mismatch");
+		}
+
+		for(size_t i = 0; i < this->registers.size(); ++i){
+			if(o.registers[i] > this->registers[i]){
+				this->registers[i] = o.registers[i];
+			}
+		}
+	}
+
+	void clear(){
+		this->registers.assign(this->registers.size(), 0);
+	}
+};
+
+#endif // HYPERLOGLOG_HPP
@@ -0,0 +1,346 @@
+#ifndef INDEXEDHYBRIDLARGEDATASTORAGE_HPP
+#define INDEXEDHYBRIDLARGEDATASTORAGE_HPP
+
+#include "IndexedNodePool.hpp"
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+template<typename Key, typename Value, size_t radix, typename ValueStore>
+class IndexedHybridLargeDataStorage;
+
+template<typename Key, typename Value, size_t radix, typename ValueStore = PlainValueStore<Value>>
+class IndexedIterator{
+	typedef IndexedNodePool<Value, radix, ValueStore> Pool;
+	typedef typename Pool::Handle Handle;
+
+	IndexedHybridLargeDataStorage<Key, Value, radix, ValueStore> *storage = nullptr;
+	size_t head = 0;
+	std::vector<Handle> branch;		// node on every tail level
+	std::vector<size_t> symbols;	// symbol taken on every tail level
+
+	// descends from `level` along the lowest existing symbols
+	void descendFirst(size_t level){
+		const Pool &pool = this->storage->pool;
+
+		for(; level < this->branch.size(); ++level){
+			const typename Pool::Node &node = pool.node(this->branch[level]);
+
+			size_t symbol = 0;
+			while(node[symbol] == Pool::null){
+				++symbol;
+			}
+
+			this->symbols[level] = symbol;
+			if(level + 1 < this->branch.size()){
+				this->branch[level + 1] = node[symbol];
+			}
+		}
+	}
+
+	void seekHead(size_t head){
+		const std::vector<Handle> &heads = this->storage->heads;
+
+		while(head < heads.size() && heads[head] == Pool::null){
+			++head;
+		}
+
+		this->head = head;
+		if(head == heads.size()){
+			this->branch.clear();
+			return;
+		}
+
+		this->branch[0] = heads[head];
+		this->descendFirst(0);
+	}
+
+public:
+	typedef size_t						difference_type;
+	typedef Value						value_type;
+	typedef Value *						pointer;
+	typedef Value &						reference;
+	typedef std::forward_iterator_tag	iterator_category;
+
+	IndexedIterator(){}
+
+	// first key at or after the head
+	IndexedIterator(IndexedHybridLargeDataStorage<Key, Value, radix, ValueStore> *storage, const size_t head):
+		storage(storage),
+		branch(storage->tailSize),
+		symbols(storage->tailSize)
+	{
+		this->seekHead(head);
+	}
+
+	IndexedIterator(IndexedHybridLargeDataStorage<Key, Value, radix, ValueStore> *storage, const size_t head, std::vector<Handle> branch, std::vector<size_t> symbols):
+		storage(storage),
+		head(head),
+		branch(std::move(branch)),
+		symbols(std::move(symbols))
+	{
+
+	}
+
+	bool operator==(const IndexedIterator &o) const{
+		if(this->branch.empty() || o.branch.empty()){
+			return this->branch.empty() == o.branch.empty();
+		}
+
+		return this->head == o.head && this->symbols == o.symbols;
+	}
+
+	bool operator!=(const IndexedIterator &o) const{
+		return !(*this == o);
+	}
+
+	typename Pool::ValueReference operator*() const{
+		const Handle leaf = this->storage->pool.node(this->branch.back())[this->symbols.back()];
+		return this->storage->pool.value(leaf);
+	}
+
+	// symbol index at the given key position, without building the key
+	size_t symbolAt(const size_t position) const{
+		const size_t headSize = this->storage->headSize;
+
+		if(position >= headSize){
+			return this->symbols[position - headSize];
+		}
+
+		size_t head = this->head;
+		for(size_t i = position + 1; i < headSize; ++i){
+			head /= radix;
+		}
+
+		return head % radix;
+	}
+
+	Key getKey() const{
+		Key key;
+		key.reserve(this->storage->keySize());
+
+		for(size_t i = 0; i < this->storage->keySize(); ++i){
+			key.push_back(Key::value_type::fromIndex(this->symbolAt(i)));
+		}
+
+		return key;
+	}
+
+	IndexedIterator &operator++(){
+		const Pool &pool = this->storage->pool;
+
+		for(size_t level = this->branch.size(); level-- > 0;){
+			const typename Pool::Node &node = pool.node(this->branch[level]);
+
+			for(size_t symbol = this->symbols[level] + 1; symbol < node.size(); ++symbol){
+				if(node[symbol] != Pool::null){
+					this->symbols[level] = symbol;
+					if(level + 1 < this->branch.size()){
+						this->branch[level + 1] = node[symbol];
+						this->descendFirst(level + 1);
+					}
+
+					return *this;
+				}
+			}
+		}
+
+		this->seekHead(this->head + 1);
+		return *this;
+	}
+};
+
+/*
+ * HybridLargeDataStorage variant whose tail trees live in one IndexedNodePool:
+ * children are 32-bit handles instead of BaseNode pointers, nodes have no vtable
+ * and the heads table holds one handle per head. An inner node takes
+ * radix * 4 bytes instead of 8 + alphabetSize * 8, a value has no node overhead.
+ *
+ * ValueStore selects the value storage, e.g. NarrowCounterStore for counts.
+ *
+ * radix below alphabetSize restricts the keys to the first radix symbols
+ * (see TwoBitHybridLargeDataStorage), other keys must not be inserted.
+ *
+ * Holds at most 2^32 - 1 inner nodes and 2^32 - 1 keys.
+ */
+template<typename Key, typename Value, size_t radix = Key::value_type::alphabetSize, typename ValueStore = PlainValueStore<Value>>
+class IndexedHybridLargeDataStorage{
+	static_assert(radix <= Key::value_type::alphabetSize, "radix exceeds the alphabet");
+
+	typedef IndexedNodePool<Value, radix, ValueStore> Pool;
+	typedef typename Pool::Handle Handle;
+
+public:
+	typedef IndexedIterator<Key, Value, radix, ValueStore> iterator;
+
+private:
+	size_t id;
+	size_t headSize;
+	size_t tailSize;
+	size_t itemCount = 0;
+
+	std::vector<Handle> heads;
+	Pool pool;
+
+	static size_t generateRandomId(){
+		static std::default_random_engine re(std::chrono::system_clock::now().time_since_epoch().count());
+		static std::uniform_int_distribution<size_t> distr;
+
+		return distr(re);
+	}
+
+	size_t headIndex(const Key &key) const{
+		size_t result = 0;
+		for(size_t i = 0; i < this->headSize; ++i){
+			assert(key[i].toIndex() < radix);
+			result = result * radix + key[i].toIndex();
+		}
+
+		return result;
+	}
+
+	// handle slot of the key's value, creating the missing inner nodes
+	Handle &descend(const Key &key){
+		assert(key.size() == this->keySize());
+
+		Handle *current = &this->heads[this->headIndex(key)];
+		for(size_t i = this->headSize; i < key.size(); ++i){
+			if(*current == Pool::null){
+				*current = this->pool.createNode();
+			}
+
+			assert(key[i].toIndex() < radix);
+			current = &this->pool.node(*current)[key[i].toIndex()];
+		}
+
+		return *current;
+	}
+
+public:
+	IndexedHybridLargeDataStorage(const size_t id, const size_t headSize, const size_t tailSize):
+		id(id),
+		headSize(headSize),
+		tailSize(tailSize)
+	{
+		if(this->tailSize == 0){
+			throw std::invalid_argument("tailSize must be positive");
+		}
+
+		size_t headCount = 1;
+		for(size_t i = 0; i < this->headSize; ++i){
+			headCount *= radix;
+		}
+
+		this->heads.assign(headCount, Pool::null);
+	}
+
+	IndexedHybridLargeDataStorage(const size_t headSize, const size_t tailSize):
+		IndexedHybridLargeDataStorage(IndexedHybridLargeDataStorage::generateRandomId(), headSize, tailSize){}
+
+	void clear(){
+		this->itemCount = 0;
+		this->heads.assign(this->heads.size(), Pool::null);
+		this->pool.clear();
+	}
+
+	size_t keySize() const{
+		return this->headSize + this->tailSize;
+	}
+
+	size_t getId() const{
+		return this->id;
+	}
+
+	size_t getHeadSize() const{
+		return this->headSize;
+	}
+
+	size_t size() const{
+		return this->itemCount;
+	}
+
+	void insert(const Key &key, const Value &value){
+		Handle &leaf = this->descend(key);
+
+		if(leaf != Pool::null){
+			throw std::runtime_error("Node with this key already exists");
+		}
+
+		leaf = this->pool.createValue(value);
+		++this->itemCount;
+	}
+
+	// inserts the key or adds value to the stored one
+	void accumulate(const Key &key, const Value &value){
+		Handle &leaf = this->descend(key);
+
+		if(leaf == Pool::null){
+			leaf = this->pool.createValue(value);
+			++this->itemCount;
+		}
+		else{
+			this->pool.value(leaf) += value;
+		}
+	}
+
+	// true if every symbol of the key is one of the first radix symbols
+	static bool accepts(const Key &key){
+		for(const typename Key::value_type &keyItem : key){
+			if(keyItem.toIndex() >= radix){
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	iterator find(const Key &key){
+		assert(key.size() == this->keySize());
+
+		if(radix < Key::value_type::alphabetSize && !IndexedHybridLargeDataStorage::accepts(key)){
+			return this->end();
+		}
+
+		const size_t head = this->headIndex(key);
+
+		std::vector<Handle> branch(this->tailSize);
+		std::vector<size_t> symbols(this->tailSize);
+
+		Handle current = this->heads[head];
+		for(size_t level = 0; level < this->tailSize; ++level){
+			if(current == Pool::null){
+				return this->end();
+			}
+
+			branch[level] = current;
+			symbols[level] = key[this->headSize + level].toIndex();
+			current = this->pool.node(current)[symbols[level]];
+		}
+
+		if(current == Pool::null){
+			return this->end();
+		}
+
+		return iterator(this, head, std::move(branch), std::move(symbols));
+	}
+
+	iterator begin(){
+		return iterator(this, 0);
+	}
+
+	iterator end(){
+		return iterator();
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return this->heads.size() * sizeof(Handle) + this->pool.getApproximateRAMUsage();
+	}
+
+	friend class IndexedIterator<Key, Value, radix, ValueStore>;
+};
+
+#endif // INDEXEDHYBRIDLARGEDATASTORAGE_HPP
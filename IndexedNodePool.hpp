@@ -0,0 +1,171 @@
+#ifndef INDEXEDNODEPOOL_HPP
+#define INDEXEDNODEPOOL_HPP
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <cassert>
+#include <stdexcept>
+
+/*
+ * Items addressed by 32-bit handles, handle 0 is reserved as null.
+ * Capacity: 2^32 - 1 items.
+ *
+ * Storage is allocated in blocks of 2^blockBits items, so growing never
+ * moves existing items and handles (and references) stay valid until clear().
+ */
+template<typename Item>
+class IndexedArena{
+public:
+	typedef uint32_t Handle;
+
+	static constexpr Handle null = 0;
+
+private:
+	static constexpr size_t blockBits = 16;
+	static constexpr size_t blockSize = size_t(1) << blockBits;
+	static constexpr size_t capacity = std::numeric_limits<Handle>::max();
+
+	std::vector<std::unique_ptr<Item[]>> blocks;
+	size_t count = 0;
+
+public:
+	Handle create(Item item){
+		if(this->count == 0){
+			this->count = 1; // skip the null handle
+		}
+
+		if(this->count > capacity){
+			throw std::length_error("IndexedArena capacity exceeded");
+		}
+
+		if((this->count >> blockBits) == this->blocks.size()){
+			this->blocks.emplace_back(new Item[blockSize]);
+		}
+
+		const Handle handle = static_cast<Handle>(this->count++);
+		(*this)[handle] = std::move(item);
+
+		return handle;
+	}
+
+	Item &operator[](const Handle handle){
+		assert(handle != null && handle < this->count);
+		return this->blocks[handle >> blockBits][handle & (blockSize - 1)];
+	}
+
+	const Item &operator[](const Handle handle) const{
+		assert(handle != null && handle < this->count);
+		return this->blocks[handle >> blockBits][handle & (blockSize - 1)];
+	}
+
+	size_t size() const{
+		return this->count == 0 ? 0 : this->count - 1;
+	}
+
+	size_t allocatedBytes() const{
+		return this->blocks.size() * blockSize * sizeof(Item);
+	}
+
+	void clear(){
+		this->blocks.clear();
+		this->count = 0;
+	}
+};
+
+template<typename Item>
+constexpr typename IndexedArena<Item>::Handle IndexedArena<Item>::null;
+
+/*
+ * Value storage policy of IndexedNodePool: create(value), operator[](handle),
+ * size(), allocatedBytes() and clear() as in IndexedArena, plus the reference
+ * and const_reference types operator[] returns. This one keeps values as they are.
+ */
+template<typename Value>
+class PlainValueStore : public IndexedArena<Value>{
+public:
+	typedef Value value_type;
+	typedef Value &reference;
+	typedef const Value &const_reference;
+};
+
+
+/*
+ * Arena of fixed-fanout trie nodes and values addressed by 32-bit handles
+ * instead of pointers. Handle 0 is reserved as null.
+ * Capacity: 2^32 - 1 nodes and 2^32 - 1 values per pool.
+ *
+ * Handles (and node references) stay valid until clear(), see IndexedArena.
+ * Values live in ValueStore, e.g. NarrowCounterStore for compact counters.
+ */
+template<typename Value, size_t fanout, typename ValueStore = PlainValueStore<Value>>
+class IndexedNodePool{
+public:
+	typedef uint32_t Handle;
+	typedef std::array<Handle, fanout> Node;
+
+	typedef typename ValueStore::reference ValueReference;
+	typedef typename ValueStore::const_reference ValueConstReference;
+
+	static constexpr Handle null = 0;
+
+private:
+	IndexedArena<Node> nodes;
+	ValueStore values;
+
+public:
+	Handle createNode(){
+		Node node;
+		node.fill(null);
+
+		return this->nodes.create(node);
+	}
+
+	Handle createValue(Value value){
+		return this->values.create(std::move(value));
+	}
+
+	Node &node(const Handle handle){
+		return this->nodes[handle];
+	}
+
+	const Node &node(const Handle handle) const{
+		return this->nodes[handle];
+	}
+
+	ValueReference value(const Handle handle){
+		return this->values[handle];
+	}
+
+	ValueConstReference value(const Handle handle) const{
+		return this->values[handle];
+	}
+
+	size_t nodeCount() const{
+		return this->nodes.size();
+	}
+
+	size_t valueCount() const{
+		return this->values.size();
+	}
+
+	const ValueStore &getValueStore() const{
+		return this->values;
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return this->nodes.allocatedBytes() + this->values.allocatedBytes();
+	}
+
+	void clear(){
+		this->nodes.clear();
+		this->values.clear();
+	}
+};
+
+template<typename Value, size_t fanout, typename ValueStore>
+constexpr typename IndexedNodePool<Value, fanout, ValueStore>::Handle IndexedNodePool<Value, fanout, ValueStore>::null;
+
+#endif // INDEXEDNODEPOOL_HPP
@@ -0,0 +1,69 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read-only shared mapping of a whole file, the page cache is shared by all the processes mapping it
+class MappedFile{
+	void *address = nullptr;
+	size_t length = 0;
+
+	static std::runtime_error error(const std::string &what, const std::string &path){
+		return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+	}
+
+public:
+	explicit MappedFile(const std::string &path){
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0){
+			throw MappedFile::error("Can't open", path);
+		}
+
+		struct stat info;
+		if(::fstat(fd, &info) != 0){
+			::close(fd);
+			throw MappedFile::error("Can't stat", path);
+		}
+
+		this->length = static_cast<size_t>(info.st_size);
+		if(this->length == 0){
+			::close(fd);
+			throw std::runtime_error("Can't map empty file " + path);
+		}
+
+		this->address = ::mmap(nullptr, this->length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+
+		if(this->address == MAP_FAILED){
+			this->address = nullptr;
+			throw MappedFile::error("Can't map", path);
+		}
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile(){
+		if(this->address != nullptr){
+			::munmap(this->address, this->length);
+		}
+	}
+
+	const char *data() const{
+		return static_cast<const char *>(this->address);
+	}
+
+	size_t size() const{
+		return this->length;
+	}
+};
+
+#endif // MAPPEDFILE_HPP
@@ -0,0 +1,247 @@
+#ifndef MINIMALPERFECTHASHINDEX_HPP
+#define MINIMALPERFECTHASHINDEX_HPP
+
+#include "HLDSDump.hpp"
+#include "RankSelectBitVector.hpp"
+#include "PackedArray.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+template<typename Key, typename Value>
+class HybridLargeDataStorage;
+
+/*
+ * Membership/count index over a fixed key set.
+ * Keys are mapped to slots [0, size()) by a BBHash-style minimal perfect hash:
+ * every level is a bit array of gamma * (keys left) bits, keys hashed to
+ * a position no other key of the level hits get that bit, the rest fall
+ * through to the next level. The slot is the rank of the bit in all levels.
+ *
+ * Absent keys are rejected by a fingerprintBits-wide fingerprint per slot
+ * (false positive rate 2^-fingerprintBits). Values are bit-packed per slot.
+ */
+template<typename Key, typename Value>
+class MinimalPerfectHashIndex{
+	static_assert(std::is_unsigned<Value>::value, "Value must be of an unsigned integer type");
+
+	static constexpr size_t maxLevels = 32;
+
+	size_t id;
+	size_t keyCount = 0;
+	double gamma;
+
+	RankSelectBitVector bits;
+	std::vector<size_t> levelOffsets;	// levels.size() + 1 entries
+	PackedArray fingerprints;
+	PackedArray values;
+
+	// keys which did not get a slot in maxLevels levels
+	std::unordered_map<uint64_t, Value> fallback;
+
+	static uint64_t mix(uint64_t x){
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+
+		return x;
+	}
+
+	static uint64_t hashKey(const Key &key){
+		uint64_t result = 0xcbf29ce484222325ULL;
+		for(const auto &keyItem : key){
+			result = (result ^ keyItem.toIndex()) * 0x100000001b3ULL;
+		}
+
+		return MinimalPerfectHashIndex::mix(result);
+	}
+
+	size_t levelPosition(const uint64_t hash, const size_t level) const{
+		const size_t levelSize = this->levelOffsets[level + 1] - this->levelOffsets[level];
+		const uint64_t levelHash = MinimalPerfectHashIndex::mix(hash + (level + 1) * 0x9e3779b97f4a7c15ULL);
+
+		return levelHash % levelSize;
+	}
+
+	uint64_t fingerprint(const uint64_t hash) const{
+		const size_t width = this->fingerprints.bitWidth();
+		const uint64_t fp = MinimalPerfectHashIndex::mix(hash ^ 0x5bd1e9955bd1e995ULL);
+
+		return width == 64 ? fp : fp & ((uint64_t(1) << width) - 1);
+	}
+
+	// slot of the key or size() if it has none
+	size_t slot(const uint64_t hash) const{
+		for(size_t level = 0; level + 1 < this->levelOffsets.size(); ++level){
+			const size_t position = this->levelOffsets[level] + this->levelPosition(hash, level);
+
+			if(this->bits.get(position)){
+				return this->bits.rank1(position);
+			}
+		}
+
+		return this->keyCount;
+	}
+
+	void build(const std::vector<uint64_t> &hashes, const std::vector<Value> &keyValues, const size_t fingerprintBits){
+		this->keyCount = hashes.size();
+		this->levelOffsets.assign(1, 0);
+
+		std::vector<uint64_t> remaining(hashes);
+
+		while(remaining.empty() == false && this->levelOffsets.size() <= maxLevels){
+			const size_t levelSize = std::max<size_t>(64, static_cast<size_t>(remaining.size() * this->gamma));
+			this->levelOffsets.push_back(this->levelOffsets.back() + levelSize);
+			const size_t level = this->levelOffsets.size() - 2;
+
+			std::vector<bool> seen(levelSize, false);
+			std::vector<bool> collided(levelSize, false);
+
+			for(const uint64_t hash : remaining){
+				const size_t position = this->levelPosition(hash, level);
+				if(seen[position]){
+					collided[position] = true;
+				}
+
+				seen[position] = true;
+			}
+
+			std::vector<uint64_t> next;
+			for(const uint64_t hash : remaining){
+				if(collided[this->levelPosition(hash, level)]){
+					next.push_back(hash);
+				}
+			}
+
+			for(size_t position = 0; position < levelSize; ++position){
+				this->bits.push_back(seen[position] && collided[position] == false);
+			}
+
+			remaining.swap(next);
+		}
+
+		this->bits.finalize();
+
+		const Value maxValue = keyValues.empty() ? 0 : *std::max_element(keyValues.cbegin(), keyValues.cend());
+
+		const size_t slotCount = this->bits.ones();
+		std::vector<uint64_t> slotFingerprints(slotCount, 0);
+		std::vector<uint64_t> slotValues(slotCount, 0);
+
+		this->fingerprints = PackedArray(fingerprintBits);
+
+		for(size_t i = 0; i < hashes.size(); ++i){
+			const size_t slot = this->slot(hashes[i]);
+
+			if(slot == this->keyCount){
+				this->fallback[hashes[i]] = keyValues[i];
+				continue;
+			}
+
+			slotFingerprints[slot] = this->fingerprint(hashes[i]);
+			slotValues[slot] = static_cast<uint64_t>(keyValues[i]);
+		}
+
+		this->fingerprints.reserve(slotCount);
+		this->values = PackedArray(PackedArray::requiredWidth(maxValue));
+		this->values.reserve(slotCount);
+
+		for(size_t slot = 0; slot < slotCount; ++slot){
+			this->fingerprints.push_back(slotFingerprints[slot]);
+			this->values.push_back(slotValues[slot]);
+		}
+	}
+
+public:
+	explicit MinimalPerfectHashIndex(const HybridLargeDataStorage<Key, Value> &hlds, const double gamma = 2.0, const size_t fingerprintBits = 16):
+		id(hlds.getId()),
+		gamma(gamma)
+	{
+		std::vector<uint64_t> hashes;
+		std::vector<Value> keyValues;
+		hashes.reserve(hlds.size());
+		keyValues.reserve(hlds.size());
+
+		for(auto it = hlds.begin(); it != hlds.end(); ++it){
+			hashes.push_back(MinimalPerfectHashIndex::hashKey(it.getKey()));
+			keyValues.push_back(*it);
+		}
+
+		this->build(hashes, keyValues, fingerprintBits);
+	}
+
+	MinimalPerfectHashIndex(HLDSDumpReader<Key, Value> &reader, const double gamma = 2.0, const size_t fingerprintBits = 16):
+		id(reader.getHeader().hldsId),
+		gamma(gamma)
+	{
+		std::vector<uint64_t> hashes;
+		std::vector<Value> keyValues;
+
+		while(reader.hasNext()){
+			const HLDSDumpRecord<Key, Value> record = reader.read();
+			hashes.push_back(MinimalPerfectHashIndex::hashKey(record.key));
+			keyValues.push_back(record.value);
+		}
+
+		this->build(hashes, keyValues, fingerprintBits);
+	}
+
+	size_t getId() const{
+		return this->id;
+	}
+
+	size_t size() const{
+		return this->keyCount;
+	}
+
+	bool find(const Key &key, Value &value) const{
+		const uint64_t hash = MinimalPerfectHashIndex::hashKey(key);
+		const size_t slot = this->slot(hash);
+
+		if(slot == this->keyCount){
+			const auto it = this->fallback.find(hash);
+			if(it == this->fallback.end()){
+				return false;
+			}
+
+			value = it->second;
+			return true;
+		}
+
+		if(this->fingerprints.get(slot) != this->fingerprint(hash)){
+			return false;
+		}
+
+		value = static_cast<Value>(this->values.get(slot));
+		return true;
+	}
+
+	bool contains(const Key &key) const{
+		Value value;
+		return this->find(key, value);
+	}
+
+	// stored value or 0 for absent keys
+	Value valueOf(const Key &key) const{
+		Value value = 0;
+		return this->find(key, value) ? value : 0;
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return
+			this->bits.getApproximateRAMUsage() +
+			this->fingerprints.getApproximateRAMUsage() +
+			this->values.getApproximateRAMUsage() +
+			this->levelOffsets.capacity() * sizeof(size_t) +
+			this->fallback.size() * (sizeof(uint64_t) + sizeof(Value));
+	}
+};
+
+#endif // MINIMALPERFECTHASHINDEX_HPP
@@ -0,0 +1,123 @@
+#ifndef NARROWCOUNTERSTORE_HPP
+#define NARROWCOUNTERSTORE_HPP
+
+#include "IndexedNodePool.hpp"
+
+#include <limits>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+
+/*
+ * Value storage policy of IndexedNodePool for unsigned counters: every value
+ * takes one Narrow counter, values reaching the Narrow maximum are escalated
+ * to a side table of Wide counters. With uint8_t counters and uint64_t values
+ * that is 8x less value storage as long as escalations are rare.
+ *
+ * operator[] returns a proxy that reads as Wide and supports = and +=.
+ */
+template<typename Wide, typename Narrow = uint8_t>
+class NarrowCounterStore{
+	static_assert(std::is_unsigned<Wide>::value && std::is_unsigned<Narrow>::value, "counters must be unsigned");
+	static_assert(sizeof(Narrow) < sizeof(Wide), "Narrow must be narrower than Wide");
+
+	typedef typename IndexedArena<Narrow>::Handle Handle;
+
+	static constexpr Narrow escalated = std::numeric_limits<Narrow>::max(); // the value is in the side table
+
+	IndexedArena<Narrow> counters;
+	std::unordered_map<Handle, Wide> overflow;
+
+	Wide get(const Handle handle) const{
+		const Narrow counter = this->counters[handle];
+		return counter == escalated ? this->overflow.at(handle) : counter;
+	}
+
+	void set(const Handle handle, const Wide value){
+		Narrow &counter = this->counters[handle];
+
+		if(value < escalated){
+			if(counter == escalated){
+				this->overflow.erase(handle);
+			}
+
+			counter = static_cast<Narrow>(value);
+		}
+		else{
+			counter = escalated;
+			this->overflow[handle] = value;
+		}
+	}
+
+public:
+	class reference{
+		NarrowCounterStore *store;
+		Handle handle;
+
+	public:
+		reference(NarrowCounterStore *store, const Handle handle): store(store), handle(handle){}
+
+		operator Wide() const{
+			return this->store->get(this->handle);
+		}
+
+		reference &operator=(const Wide value){
+			this->store->set(this->handle, value);
+			return *this;
+		}
+
+		reference &operator=(const reference &o){
+			return *this = static_cast<Wide>(o);
+		}
+
+		reference &operator+=(const Wide value){
+			this->store->set(this->handle, this->store->get(this->handle) + value);
+			return *this;
+		}
+	};
+
+	typedef Wide value_type;
+	typedef Wide const_reference;
+
+	Handle create(const Wide value){
+		const Handle handle = this->counters.create(Narrow());
+		this->set(handle, value);
+
+		return handle;
+	}
+
+	reference operator[](const Handle handle){
+		return reference(this, handle);
+	}
+
+	const_reference operator[](const Handle handle) const{
+		return this->get(handle);
+	}
+
+	size_t size() const{
+		return this->counters.size();
+	}
+
+	// values kept in the side table
+	size_t escalatedCount() const{
+		return this->overflow.size();
+	}
+
+	// the side table estimate counts a hash node and a bucket pointer per entry
+	size_t allocatedBytes() const{
+		return
+			this->counters.allocatedBytes() +
+			this->overflow.size() * (sizeof(typename std::unordered_map<Handle, Wide>::value_type) + 2 * sizeof(void *)) +
+			this->overflow.bucket_count() * sizeof(void *);
+	}
+
+	void clear(){
+		this->counters.clear();
+		this->overflow.clear();
+	}
+};
+
+template<typename Wide, typename Narrow>
+constexpr Narrow NarrowCounterStore<Wide, Narrow>::escalated;
+
+#endif // NARROWCOUNTERSTORE_HPP
@@ -77,6 +77,7 @@ public:
 
 	friend class TailTree<Key, Value>;
 	friend typename TailTree<Key, Value>::iterator;
+	friend typename TailTree<Key, Value>::const_iterator;
 	friend class CountingFactory<Node>;
 
 };
@@ -0,0 +1,87 @@
+#ifndef PACKEDARRAY_HPP
+#define PACKEDARRAY_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+// Array of unsigned integers stored with a fixed bit width (1..64) each
+class PackedArray{
+	std::vector<uint64_t> words;
+	size_t width;
+	size_t count = 0;
+
+	uint64_t mask() const{
+		return this->width == 64 ? ~uint64_t(0) : (uint64_t(1) << this->width) - 1;
+	}
+
+public:
+	explicit PackedArray(const size_t width = 64): width(width){
+		assert(width > 0 && width <= 64);
+	}
+
+	static size_t requiredWidth(uint64_t maxValue){
+		size_t result = 1;
+		while(maxValue >>= 1){
+			++result;
+		}
+
+		return result;
+	}
+
+	size_t size() const{
+		return this->count;
+	}
+
+	size_t bitWidth() const{
+		return this->width;
+	}
+
+	void reserve(const size_t count){
+		this->words.reserve((count * this->width + 63) / 64);
+	}
+
+	void push_back(const uint64_t value){
+		assert((value & ~this->mask()) == 0);
+
+		const size_t bitPos = this->count * this->width;
+		const size_t word = bitPos / 64;
+		const size_t offset = bitPos % 64;
+
+		while(this->words.size() <= (bitPos + this->width - 1) / 64){
+			this->words.push_back(0);
+		}
+
+		this->words[word] |= value << offset;
+		if(offset + this->width > 64){
+			this->words[word + 1] |= value >> (64 - offset);
+		}
+
+		++this->count;
+	}
+
+	uint64_t get(const size_t index) const{
+		assert(index < this->count);
+
+		const size_t bitPos = index * this->width;
+		const size_t word = bitPos / 64;
+		const size_t offset = bitPos % 64;
+
+		uint64_t result = this->words[word] >> offset;
+		if(offset + this->width > 64){
+			result |= this->words[word + 1] << (64 - offset);
+		}
+
+		return result & this->mask();
+	}
+
+	void shrink_to_fit(){
+		this->words.shrink_to_fit();
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return this->words.capacity() * sizeof(uint64_t);
+	}
+};
+
+#endif // PACKEDARRAY_HPP
@@ -0,0 +1,133 @@
+#ifndef RANKSELECTBITVECTOR_HPP
+#define RANKSELECTBITVECTOR_HPP
+
+#include <vector>
+#include <bitset>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+
+/*
+ * Append-only bit vector with constant time rank and logarithmic select.
+ * One 64-bit cumulative count is kept per 512 bits (12.5% overhead).
+ * Call finalize() after the last push_back() and before any rank/select.
+ */
+class RankSelectBitVector{
+	static constexpr size_t wordBits = 64;
+	static constexpr size_t wordsPerBlock = 8;
+
+	std::vector<uint64_t> words;
+	std::vector<uint64_t> blockRanks;	// ones before the block
+	size_t bitCount = 0;
+
+	static size_t popcount(const uint64_t word){
+		return std::bitset<wordBits>(word).count();
+	}
+
+	// position of the n-th (0-based) set bit of the word
+	static size_t selectInWord(uint64_t word, size_t n){
+		while(n > 0){
+			word &= word - 1;
+			--n;
+		}
+
+		size_t position = 0;
+		while((word & 1) == 0){
+			word >>= 1;
+			++position;
+		}
+
+		return position;
+	}
+
+public:
+	void push_back(const bool bit){
+		if(this->bitCount % wordBits == 0){
+			this->words.push_back(0);
+		}
+
+		if(bit){
+			this->words.back() |= uint64_t(1) << (this->bitCount % wordBits);
+		}
+
+		++this->bitCount;
+	}
+
+	void finalize(){
+		this->words.shrink_to_fit();
+
+		this->blockRanks.clear();
+		this->blockRanks.reserve(this->words.size() / wordsPerBlock + 1);
+
+		uint64_t ones = 0;
+		for(size_t i = 0; i < this->words.size(); ++i){
+			if(i % wordsPerBlock == 0){
+				this->blockRanks.push_back(ones);
+			}
+
+			ones += RankSelectBitVector::popcount(this->words[i]);
+		}
+
+		this->blockRanks.push_back(ones);
+	}
+
+	size_t size() const{
+		return this->bitCount;
+	}
+
+	bool get(const size_t position) const{
+		assert(position < this->bitCount);
+		return (this->words[position / wordBits] >> (position % wordBits)) & 1;
+	}
+
+	// number of set bits in [0, position)
+	size_t rank1(const size_t position) const{
+		assert(position <= this->bitCount);
+
+		const size_t word = position / wordBits;
+		const size_t block = word / wordsPerBlock;
+
+		size_t result = this->blockRanks[block];
+		for(size_t i = block * wordsPerBlock; i < word; ++i){
+			result += RankSelectBitVector::popcount(this->words[i]);
+		}
+
+		const size_t bit = position % wordBits;
+		if(bit != 0){
+			result += RankSelectBitVector::popcount(this->words[word] & ((uint64_t(1) << bit) - 1));
+		}
+
+		return result;
+	}
+
+	size_t ones() const{
+		return this->blockRanks.back();
+	}
+
+	// position of the n-th (0-based) set bit, n must be less than ones()
+	size_t select1(size_t n) const{
+		assert(n < this->ones());
+
+		const auto blockIt = std::upper_bound(this->blockRanks.cbegin(), this->blockRanks.cend(), n) - 1;
+		size_t word = (blockIt - this->blockRanks.cbegin()) * wordsPerBlock;
+		n -= *blockIt;
+
+		while(true){
+			const size_t wordOnes = RankSelectBitVector::popcount(this->words[word]);
+			if(n < wordOnes){
+				break;
+			}
+
+			n -= wordOnes;
+			++word;
+		}
+
+		return word * wordBits + RankSelectBitVector::selectInWord(this->words[word], n);
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return (this->words.capacity() + this->blockRanks.capacity()) * sizeof(uint64_t);
+	}
+};
+
+#endif // RANKSELECTBITVECTOR_HPP
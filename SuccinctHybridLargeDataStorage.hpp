@@ -0,0 +1,332 @@
+#ifndef SUCCINCTHYBRIDLARGEDATASTORAGE_HPP
+#define SUCCINCTHYBRIDLARGEDATASTORAGE_HPP
+
+#include "HLDSDump.hpp"
+#include "RankSelectBitVector.hpp"
+#include "PackedArray.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+template<typename Key, typename Value>
+class HybridLargeDataStorage;
+
+template<typename Key, typename Value>
+class SuccinctHybridLargeDataStorage;
+
+template<typename Key, typename Value>
+class SuccinctIterator{
+	const SuccinctHybridLargeDataStorage<Key, Value> *storage = nullptr;
+	size_t head = 0;
+	std::vector<size_t> edges; // edge index per tail level
+
+public:
+	typedef size_t						difference_type;
+	typedef Value						value_type;
+	typedef const Value *				pointer;
+	typedef Value						reference;
+	typedef std::forward_iterator_tag	iterator_category;
+
+	SuccinctIterator(){}
+
+	SuccinctIterator(const SuccinctHybridLargeDataStorage<Key, Value> *storage, const size_t head, std::vector<size_t> edges):
+		storage(storage),
+		head(head),
+		edges(std::move(edges))
+	{
+
+	}
+
+	bool operator==(const SuccinctIterator &o) const{
+		return this->edges.back() == o.edges.back();
+	}
+
+	bool operator!=(const SuccinctIterator &o) const{
+		return !(*this == o);
+	}
+
+	Value operator*() const{
+		return static_cast<Value>(this->storage->values.get(this->edges.back()));
+	}
+
+	Key getKey() const{
+		Key key = Key::fromIndex(this->head, this->storage->headSize);
+		key.reserve(this->storage->keySize());
+
+		for(size_t level = 0; level < this->edges.size(); ++level){
+			key.push_back(Key::value_type::fromIndex(this->storage->labels[level].get(this->edges[level])));
+		}
+
+		return key;
+	}
+
+	SuccinctIterator &operator++(){
+		size_t level = this->edges.size() - 1;
+		++this->edges[level];
+
+		if(this->edges[level] == this->storage->size()){
+			return *this; // end
+		}
+
+		// a new node at some level means the next edge of its parent
+		while(this->storage->nodeStarts[level].get(this->edges[level])){
+			if(level == 0){
+				const size_t node = this->storage->nodeStarts[0].rank1(this->edges[0] + 1) - 1;
+				this->head = this->storage->headPresent.select1(node);
+				break;
+			}
+
+			--level;
+			++this->edges[level];
+		}
+
+		return *this;
+	}
+};
+
+/*
+ * Read-only storage for archival key sets: every tail tree is encoded
+ * level by level (LOUDS-style, as all tails have the same depth):
+ *	- labels[l]: symbol of every edge on tail level l, ordered by node, then by symbol
+ *	- nodeStarts[l]: set for the first edge of every node on level l
+ * Node k on level l + 1 is the child of edge k on level l, nodes on level 0 are
+ * the non-empty heads in order (headPresent with rank/select maps between them).
+ * Values of the last level edges are bit-packed with the minimal width.
+ *
+ * Takes about (binarySize + 1) * 1.125 bits per edge plus the value width per key.
+ */
+template<typename Key, typename Value>
+class SuccinctHybridLargeDataStorage{
+	static_assert(std::is_integral<Value>::value, "Value must be of an integer type");
+
+public:
+	typedef SuccinctIterator<Key, Value> iterator;
+	typedef SuccinctIterator<Key, Value> const_iterator;
+
+private:
+	size_t id;
+	size_t headSize;
+	size_t tailSize;
+
+	RankSelectBitVector headPresent;
+	std::vector<PackedArray> labels;
+	std::vector<RankSelectBitVector> nodeStarts;
+	PackedArray values;
+
+	// build state
+	std::vector<Value> pendingValues;
+	Key previousKey;
+	size_t previousHead = 0;
+
+	size_t headCount() const{
+		size_t result = 1;
+		for(size_t i = 0; i < this->headSize; ++i){
+			result *= Key::value_type::alphabetSize;
+		}
+
+		return result;
+	}
+
+	size_t headIndex(const Key &key) const{
+		size_t head = 0;
+		for(size_t i = 0; i < this->headSize; ++i){
+			head = head * Key::value_type::alphabetSize + key[i].toIndex();
+		}
+
+		return head;
+	}
+
+	void init(const size_t headSize, const size_t tailSize){
+		if(tailSize == 0){
+			throw std::invalid_argument("tailSize must be positive");
+		}
+
+		this->headSize = headSize;
+		this->tailSize = tailSize;
+
+		const size_t labelWidth = PackedArray::requiredWidth(Key::value_type::alphabetSize - 1);
+		this->labels.assign(this->tailSize, PackedArray(labelWidth));
+		this->nodeStarts.assign(this->tailSize, RankSelectBitVector());
+	}
+
+	// keys must be appended in ascending order
+	void append(const Key &key, const Value &value){
+		assert(key.size() == this->keySize());
+
+		const size_t head = this->headIndex(key);
+		const bool newHead = this->pendingValues.empty() || head != this->previousHead;
+
+		size_t firstNewLevel = 0;
+		if(newHead){
+			if(this->pendingValues.empty() == false && head < this->previousHead){
+				throw std::invalid_argument("Keys must be sorted");
+			}
+
+			while(this->headPresent.size() < head){
+				this->headPresent.push_back(false);
+			}
+			this->headPresent.push_back(true);
+		}
+		else{
+			while(firstNewLevel < this->tailSize && key[this->headSize + firstNewLevel] == this->previousKey[this->headSize + firstNewLevel]){
+				++firstNewLevel;
+			}
+
+			if(firstNewLevel == this->tailSize || key[this->headSize + firstNewLevel] < this->previousKey[this->headSize + firstNewLevel]){
+				throw std::invalid_argument("Keys must be sorted and unique");
+			}
+		}
+
+		for(size_t level = firstNewLevel; level < this->tailSize; ++level){
+			this->labels[level].push_back(key[this->headSize + level].toIndex());
+			this->nodeStarts[level].push_back(newHead || level > firstNewLevel);
+		}
+
+		this->pendingValues.push_back(value);
+		this->previousKey = key;
+		this->previousHead = head;
+	}
+
+	void finish(){
+		while(this->headPresent.size() < this->headCount()){
+			this->headPresent.push_back(false);
+		}
+		this->headPresent.finalize();
+
+		for(size_t level = 0; level < this->tailSize; ++level){
+			this->labels[level].shrink_to_fit();
+			this->nodeStarts[level].finalize();
+		}
+
+		Value maxValue = 0;
+		for(const Value &value : this->pendingValues){
+			if(value < 0){
+				throw std::invalid_argument("Values must be non-negative");
+			}
+
+			maxValue = std::max(maxValue, value);
+		}
+
+		this->values = PackedArray(PackedArray::requiredWidth(maxValue));
+		this->values.reserve(this->pendingValues.size());
+		for(const Value &value : this->pendingValues){
+			this->values.push_back(static_cast<uint64_t>(value));
+		}
+
+		std::vector<Value>().swap(this->pendingValues);
+		this->previousKey = Key();
+	}
+
+	// edges of node `node` on `level` occupy [first, last)
+	std::pair<size_t, size_t> nodeEdges(const size_t level, const size_t node) const{
+		const RankSelectBitVector &starts = this->nodeStarts[level];
+
+		const size_t first = starts.select1(node);
+		const size_t last = node + 1 < starts.ones() ? starts.select1(node + 1) : starts.size();
+
+		return std::make_pair(first, last);
+	}
+
+public:
+	explicit SuccinctHybridLargeDataStorage(const HybridLargeDataStorage<Key, Value> &hlds):
+		id(hlds.getId())
+	{
+		this->init(hlds.getHeadSize(), hlds.keySize() - hlds.getHeadSize());
+
+		for(auto it = hlds.begin(); it != hlds.end(); ++it){
+			this->append(it.getKey(), *it);
+		}
+
+		this->finish();
+	}
+
+	SuccinctHybridLargeDataStorage(HLDSDumpReader<Key, Value> &reader, const size_t headSize):
+		id(reader.getHeader().hldsId)
+	{
+		this->init(headSize, reader.getHeader().keySize - headSize);
+
+		while(reader.hasNext()){
+			const HLDSDumpRecord<Key, Value> record = reader.read();
+			this->append(record.key, record.value);
+		}
+
+		this->finish();
+	}
+
+	size_t keySize() const{
+		return this->headSize + this->tailSize;
+	}
+
+	size_t getId() const{
+		return this->id;
+	}
+
+	size_t size() const{
+		return this->values.size();
+	}
+
+	const_iterator find(const Key &key) const{
+		assert(key.size() == this->keySize());
+
+		const size_t head = this->headIndex(key);
+		if(this->headPresent.get(head) == false){
+			return this->end();
+		}
+
+		std::vector<size_t> edges(this->tailSize);
+		size_t node = this->headPresent.rank1(head);
+
+		for(size_t level = 0; level < this->tailSize; ++level){
+			const std::pair<size_t, size_t> range = this->nodeEdges(level, node);
+			const uint64_t symbol = key[this->headSize + level].toIndex();
+
+			size_t edge = range.first;
+			while(edge < range.second && this->labels[level].get(edge) < symbol){
+				++edge;
+			}
+
+			if(edge == range.second || this->labels[level].get(edge) != symbol){
+				return this->end();
+			}
+
+			edges[level] = edge;
+			node = edge;
+		}
+
+		return const_iterator(this, head, std::move(edges));
+	}
+
+	const_iterator begin() const{
+		if(this->size() == 0){
+			return this->end();
+		}
+
+		return const_iterator(this, this->headPresent.select1(0), std::vector<size_t>(this->tailSize, 0));
+	}
+
+	const_iterator end() const{
+		std::vector<size_t> edges(this->tailSize, 0);
+		edges.back() = this->size();
+
+		return const_iterator(this, this->headCount(), std::move(edges));
+	}
+
+	size_t getApproximateRAMUsage() const{
+		size_t result = this->headPresent.getApproximateRAMUsage() + this->values.getApproximateRAMUsage();
+
+		for(size_t level = 0; level < this->tailSize; ++level){
+			result += this->labels[level].getApproximateRAMUsage();
+			result += this->nodeStarts[level].getApproximateRAMUsage();
+		}
+
+		return result;
+	}
+
+	friend class SuccinctIterator<Key, Value>;
+};
+
+#endif // SUCCINCTHYBRIDLARGEDATASTORAGE_HPP
@@ -6,19 +6,43 @@
 #include "ValueNode.hpp"
 #include "TailTreeIterator.hpp"
 #include "CountingFactory.hpp"
+#include "HLDSReducers.hpp"
 
+#include <atomic>
 #include <stdexcept>
+#include <type_traits>
+
+template<typename Key, typename Value>
+class HeadsPager;
+
+template<typename Key, typename Value>
+class HeadsHolder;
 
 template<typename Key, typename Value>
 class TailTree{
 	BaseNode<Key, Value> *root = nullptr;
 	const size_t depth;
 
-	const CountingFactory<Node<Key, Value>> &nodeFactory;
-	const CountingFactory<ValueNode<Key, Value>> &valueNodeFactory;
+	HeadsPager<Key, Value> *pager = nullptr;
+	bool paged = false; // content lives in the pager's spill file
+
+	// owner count of root while it is shared with copies, nullptr while this tree owns it alone
+	mutable std::atomic<size_t> *sharers = nullptr;
+
+	const CountingFactory<Node<Key, Value>> *nodeFactory;
+	const CountingFactory<ValueNode<Key, Value>> *valueNodeFactory;
 
 public:
-	typedef TailTreeIterator<Key, Value> iterator;
+	typedef TailTreeIterator<Key, Value, false> iterator;
+	typedef TailTreeIterator<Key, Value, true> const_iterator;
+
+	struct MergeStats{
+		size_t nodes = 0;		// nodes moved or copied in from the other tree
+		size_t valueNodes = 0;	// values moved or copied in, i.e. keys added
+		size_t shared = 0;		// keys present in both trees
+		size_t singles = 0;		// keys of one tree only run through the reducer
+		size_t rejected = 0;	// values dropped here because the reducer did not accept them
+	};
 
 	TailTree(
 		const size_t depth,
@@ -26,15 +50,19 @@ public:
 		const CountingFactory<ValueNode<Key, Value>> &valueNodeFactory
 	):
 		depth(depth),
-		nodeFactory(nodeFactory),
-		valueNodeFactory(valueNodeFactory)
+		nodeFactory(&nodeFactory),
+		valueNodeFactory(&valueNodeFactory)
 	{
 
 	}
 
+	// shares the nodes of tailTree, each tree copies them on its first modification
 	TailTree(const TailTree &tailTree):
 		root(tailTree.root),
 		depth(tailTree.depth),
+		pager(tailTree.pager),
+		paged(tailTree.paged),
+		sharers(tailTree.share()),
 		nodeFactory(tailTree.nodeFactory),
 		valueNodeFactory(tailTree.valueNodeFactory)
 	{
@@ -44,17 +72,85 @@ public:
 	TailTree(TailTree &&tailTree):
 		root(tailTree.root),
 		depth(tailTree.depth),
+		pager(tailTree.pager),
+		paged(tailTree.paged),
+		sharers(tailTree.sharers),
 		nodeFactory(tailTree.nodeFactory),
 		valueNodeFactory(tailTree.valueNodeFactory)
 	{
 		tailTree.root = nullptr;
+		tailTree.paged = false;
+		tailTree.sharers = nullptr;
 	}
 
 	~TailTree(){
-		delete this->root;
+		this->releaseRoot();
 	}
 
-	void addTail(const Key &key, Value value){
+private:
+	std::atomic<size_t> *share() const{
+		if(this->root == nullptr){
+			return nullptr;
+		}
+
+		if(this->sharers == nullptr){
+			this->sharers = new std::atomic<size_t>(1);
+		}
+
+		++*this->sharers;
+		return this->sharers;
+	}
+
+	bool isShared() const{
+		return this->sharers != nullptr && this->sharers->load() > 1;
+	}
+
+	// gives up this tree's ownership of root, the last owner frees the nodes
+	void releaseRoot(){
+		if(this->sharers != nullptr){
+			if(--*this->sharers == 0){
+				delete this->root;
+				delete this->sharers;
+			}
+
+			this->sharers = nullptr;
+		}
+		else{
+			delete this->root;
+		}
+
+		this->root = nullptr;
+	}
+
+	// makes root exclusive to this tree before a modification, copying it if other trees share it
+	void detach(){
+		if(this->sharers == nullptr){
+			return;
+		}
+
+		if(this->sharers->load() > 1){
+			// this tree has counted the shared nodes already, the copies replace them
+			MergeStats stats;
+			BaseNode<Key, Value> *copy = this->copy(this->root, stats);
+			this->nodeFactory->release(stats.nodes);
+			this->valueNodeFactory->release(stats.valueNodes);
+
+			this->releaseRoot();
+			this->root = copy;
+		}
+		else{
+			delete this->sharers;
+			this->sharers = nullptr;
+		}
+	}
+
+	// touch() for a modification
+	void touchForWrite(){
+		this->touch();
+		this->detach();
+	}
+
+	BaseNode<Key, Value> **descend(const Key &key){
 		assert(key.size() == depth - 1);
 
 		BaseNode<Key, Value> **current = &this->root;
@@ -62,7 +158,7 @@ public:
 			Node<Key, Value> *node = nullptr;
 
 			if(*current == nullptr){
-				node = this->nodeFactory.create();
+				node = this->nodeFactory->create();
 				*current = node;
 			}
 			else{
@@ -74,21 +170,295 @@ public:
 			current = &node->tails.at(keyItem.toIndex());
 		}
 
+		return current;
+	}
+
+	// same as descend() for the tail given by its Key::toIndex()
+	BaseNode<Key, Value> **descendIndex(const size_t tailIndex){
+		size_t divisor = 1;
+		for(size_t i = 2; i < this->depth; ++i){
+			divisor *= Key::value_type::alphabetSize;
+		}
+
+		BaseNode<Key, Value> **current = &this->root;
+		for(size_t i = 1; i < this->depth; ++i){
+			Node<Key, Value> *node = nullptr;
+
+			if(*current == nullptr){
+				node = this->nodeFactory->create();
+				*current = node;
+			}
+			else{
+				assert((dynamic_cast<Node<Key, Value> *>(*current) != nullptr));
+				node = static_cast<Node<Key, Value> *>(*current);
+			}
+
+			current = &node->tails[(tailIndex / divisor) % Key::value_type::alphabetSize];
+			divisor /= Key::value_type::alphabetSize;
+		}
+
+		return current;
+	}
+
+	void insert(const Key &key, Value value){
+		BaseNode<Key, Value> **current = this->descend(key);
+
 		if(*current != nullptr){
 			throw std::runtime_error("Node with this key already exists");
 		}
 
-		*current = this->valueNodeFactory.create(std::move(value));
+		*current = this->valueNodeFactory->create(std::move(value));
 	}
 
-public:
-	bool isEmpty() const{
-		return this->root == nullptr;
+	// faults the tree in if it was paged out
+	void touch() const{
+		if(this->pager != nullptr){
+			this->pager->access(*this);
+		}
+	}
+
+	static void countNodes(const BaseNode<Key, Value> *base, size_t &nodes, size_t &valueNodes){
+		const Node<Key, Value> *node = dynamic_cast<const Node<Key, Value> *>(base);
+		if(node == nullptr){
+			valueNodes += base != nullptr ? 1 : 0;
+			return;
+		}
+
+		++nodes;
+		for(const BaseNode<Key, Value> *tail : node->tails){
+			if(tail != nullptr){
+				TailTree::countNodes(tail, nodes, valueNodes);
+			}
+		}
+	}
+
+	// erases matching values below slot, returns true if the whole subtree is gone
+	template<typename Predicate>
+	static bool eraseIf(BaseNode<Key, Value> *&slot, Key &key, Predicate &predicate, size_t &nodes, size_t &valueNodes){
+		Node<Key, Value> *node = dynamic_cast<Node<Key, Value> *>(slot);
+
+		if(node == nullptr){
+			assert((dynamic_cast<ValueNode<Key, Value> *>(slot) != nullptr));
+
+			if(!predicate(static_cast<const Key &>(key), static_cast<const ValueNode<Key, Value> *>(slot)->getValue())){
+				return false;
+			}
+
+			++valueNodes;
+		}
+		else{
+			bool empty = true;
+
+			for(size_t i = 0; i < node->tails.size(); ++i){
+				if(node->tails[i] == nullptr){
+					continue;
+				}
+
+				key.push_back(Key::value_type::fromIndex(i));
+				empty = TailTree::eraseIf(node->tails[i], key, predicate, nodes, valueNodes) && empty;
+				key.pop_back();
+			}
+
+			if(!empty){
+				return false;
+			}
+
+			++nodes;
+		}
+
+		delete slot;
+		slot = nullptr;
+
+		return true;
+	}
+
+	// visits the subtree below base, position is the key item its branches set
+	template<typename Visitor>
+	static void forEach(const BaseNode<Key, Value> *base, Key &key, const size_t position, Visitor &visitor){
+		if(position == key.size()){
+			assert((dynamic_cast<const ValueNode<Key, Value> *>(base) != nullptr));
+			visitor(static_cast<const Key &>(key), static_cast<const ValueNode<Key, Value> *>(base)->getValue());
+			return;
+		}
+
+		assert((dynamic_cast<const Node<Key, Value> *>(base) != nullptr));
+		const Node<Key, Value> *node = static_cast<const Node<Key, Value> *>(base);
+
+		for(size_t i = 0; i < node->tails.size(); ++i){
+			if(node->tails[i] != nullptr){
+				key[position] = Key::value_type::fromIndex(i);
+				TailTree::forEach(node->tails[i], key, position + 1, visitor);
+			}
+		}
+	}
+
+	// merges src (a subtree of srcTree) into dst, returns true if dst ends up empty
+	template<typename Reducer>
+	bool mergeMove(BaseNode<Key, Value> *&dst, BaseNode<Key, Value> *&src, TailTree &srcTree, const Reducer &reducer, MergeStats &stats){
+		if(src == nullptr){
+			return this->reduceSingles(dst, 0, reducer, stats);
+		}
+
+		if(dst == nullptr){
+			// reduced while still counted by srcTree, only the accepted part is spliced in
+			MergeStats dropped;
+			srcTree.reduceSingles(src, 1, reducer, dropped);
+
+			TailTree::countNodes(src, stats.nodes, stats.valueNodes);
+			dst = src;
+			src = nullptr;
+
+			return dst == nullptr;
+		}
+
+		Node<Key, Value> *dstNode = dynamic_cast<Node<Key, Value> *>(dst);
+		if(dstNode == nullptr){
+			return this->mergeValues(dst, static_cast<const ValueNode<Key, Value> *>(src)->getValue(), reducer, stats);
+		}
+
+		Node<Key, Value> *srcNode = static_cast<Node<Key, Value> *>(src);
+		for(size_t i = 0; i < dstNode->tails.size(); ++i){
+			this->mergeMove(dstNode->tails[i], srcNode->tails[i], srcTree, reducer, stats);
+		}
+
+		return this->dropIfEmpty(dst);
+	}
+
+	// same as mergeMove() leaving src intact, missing subtrees are copied
+	template<typename Reducer>
+	bool mergeCopy(BaseNode<Key, Value> *&dst, const BaseNode<Key, Value> *src, const Reducer &reducer, MergeStats &stats){
+		if(src == nullptr){
+			return this->reduceSingles(dst, 0, reducer, stats);
+		}
+
+		if(dst == nullptr){
+			dst = this->copy(src, stats);
+			return this->reduceSingles(dst, 1, reducer, stats);
+		}
+
+		Node<Key, Value> *dstNode = dynamic_cast<Node<Key, Value> *>(dst);
+		if(dstNode == nullptr){
+			return this->mergeValues(dst, static_cast<const ValueNode<Key, Value> *>(src)->getValue(), reducer, stats);
+		}
+
+		const Node<Key, Value> *srcNode = static_cast<const Node<Key, Value> *>(src);
+		for(size_t i = 0; i < dstNode->tails.size(); ++i){
+			this->mergeCopy(dstNode->tails[i], srcNode->tails[i], reducer, stats);
+		}
+
+		return this->dropIfEmpty(dst);
+	}
+
+	template<typename Reducer>
+	bool mergeValues(BaseNode<Key, Value> *&dst, const Value &value, const Reducer &reducer, MergeStats &stats){
+		assert((dynamic_cast<ValueNode<Key, Value> *>(dst) != nullptr));
+
+		typename Reducer::OutValue accumulator = reducer.identity();
+		reducer.accumulate(accumulator, 0, static_cast<ValueNode<Key, Value> *>(dst)->getValue());
+		reducer.accumulate(accumulator, 1, value);
+
+		++stats.shared;
+
+		if(this->storeReduced(dst, accumulator, reducer)){
+			return false;
+		}
+
+		++stats.rejected;
+		return true;
+	}
+
+	/*
+	 * Runs the values of a subtree only one of the merged trees has through the
+	 * reducer like the dump mergers do (identity(), accumulate() with source,
+	 * accept()), so both merge paths keep the same keys. Returns true if node
+	 * ends up empty.
+	 */
+	template<typename Reducer>
+	bool reduceSingles(BaseNode<Key, Value> *&node, const size_t source, const Reducer &reducer, MergeStats &stats){
+		if(node == nullptr || KeepsSingleValues<Reducer>::value){
+			return node == nullptr;
+		}
+
+		Node<Key, Value> *inner = dynamic_cast<Node<Key, Value> *>(node);
+		if(inner == nullptr){
+			typename Reducer::OutValue accumulator = reducer.identity();
+			reducer.accumulate(accumulator, source, static_cast<ValueNode<Key, Value> *>(node)->getValue());
+
+			++stats.singles;
+
+			if(this->storeReduced(node, accumulator, reducer)){
+				return false;
+			}
+
+			++stats.rejected;
+			return true;
+		}
+
+		for(BaseNode<Key, Value> *&tail : inner->tails){
+			this->reduceSingles(tail, source, reducer, stats);
+		}
+
+		return this->dropIfEmpty(node);
 	}
 
-	iterator begin() const{
-		if(this->isEmpty()){
-			return iterator();
+	// stores accumulator in the value node if the reducer accepts it, erases the node otherwise
+	template<typename Reducer>
+	bool storeReduced(BaseNode<Key, Value> *&valueNode, const typename Reducer::OutValue &accumulator, const Reducer &reducer){
+		static_assert(std::is_convertible<const Value &, typename Reducer::InValue>::value, "merge(): the reducer's InValue must be constructible from the stored Value");
+		static_assert(std::is_convertible<typename Reducer::OutValue, Value>::value, "merge(): the reducer's OutValue is stored back in the tree and must convert to Value");
+
+		if(reducer.accept(accumulator)){
+			static_cast<ValueNode<Key, Value> *>(valueNode)->getValue() = accumulator;
+			return true;
+		}
+
+		delete valueNode;
+		valueNode = nullptr;
+		this->valueNodeFactory->release(1);
+
+		return false;
+	}
+
+	bool dropIfEmpty(BaseNode<Key, Value> *&dst){
+		const Node<Key, Value> *node = static_cast<const Node<Key, Value> *>(dst);
+
+		for(const BaseNode<Key, Value> *tail : node->tails){
+			if(tail != nullptr){
+				return false;
+			}
+		}
+
+		delete dst;
+		dst = nullptr;
+		this->nodeFactory->release(1);
+
+		return true;
+	}
+
+	BaseNode<Key, Value> *copy(const BaseNode<Key, Value> *src, MergeStats &stats){
+		const Node<Key, Value> *srcNode = dynamic_cast<const Node<Key, Value> *>(src);
+
+		if(srcNode == nullptr){
+			++stats.valueNodes;
+			return this->valueNodeFactory->create(static_cast<const ValueNode<Key, Value> *>(src)->getValue());
+		}
+
+		Node<Key, Value> *node = this->nodeFactory->create();
+		++stats.nodes;
+
+		for(size_t i = 0; i < srcNode->tails.size(); ++i){
+			if(srcNode->tails[i] != nullptr){
+				node->tails[i] = this->copy(srcNode->tails[i], stats);
+			}
+		}
+
+		return node;
+	}
+
+	template<typename Iterator = iterator>
+	Iterator first() const{
+		if(this->root == nullptr){
+			return Iterator();
 		}
 
 		BranchHolder<Key, Value> branch;
@@ -107,16 +477,13 @@ public:
 		}
 
 
-		return iterator(std::move(key), std::move(branch));
-	}
-
-	iterator end() const{
-		return iterator();
+		return Iterator(std::move(key), std::move(branch));
 	}
 
-	iterator find(Key key) const{
+	template<typename Iterator>
+	Iterator locate(Key key) const{
 		if(this->root == nullptr){
-			return iterator();
+			return Iterator();
 		}
 
 		BranchHolder<Key, Value> branch;
@@ -129,29 +496,248 @@ public:
 
 			BaseNode<Key, Value> *next = node->tails.at(value.toIndex());
 			if(next == nullptr){
-				return iterator();
+				return Iterator();
 			}
 
 			branch.push_back(next);
 		}
 
-		return iterator(std::move(key), std::move(branch));
+		return Iterator(std::move(key), std::move(branch));
+	}
+
+public:
+	void addTail(const Key &key, Value value){
+		this->touchForWrite();
+		this->insert(key, std::move(value));
+	}
+
+	// adds value to the existing one or inserts it, returns true if a new tail was created
+	bool accumulate(const Key &key, const Value &value){
+		this->touchForWrite();
+		BaseNode<Key, Value> **current = this->descend(key);
+
+		if(*current == nullptr){
+			*current = this->valueNodeFactory->create(value);
+			return true;
+		}
+
+		ValueNode<Key, Value> *valueNode = dynamic_cast<ValueNode<Key, Value> *>(*current);
+		assert(valueNode != nullptr);
+
+		valueNode->getValue() += value;
+		return false;
+	}
+
+	// value of the tail given by its Key::toIndex(), nullptr if there is none
+	const Value *findIndex(const size_t tailIndex) const{
+		this->touch();
+
+		size_t divisor = 1;
+		for(size_t i = 2; i < this->depth; ++i){
+			divisor *= Key::value_type::alphabetSize;
+		}
+
+		BaseNode<Key, Value> *current = this->root;
+		for(size_t i = 1; i < this->depth && current != nullptr; ++i){
+			assert((dynamic_cast<Node<Key, Value> *>(current) != nullptr));
+
+			current = static_cast<Node<Key, Value> *>(current)->tails[(tailIndex / divisor) % Key::value_type::alphabetSize];
+			divisor /= Key::value_type::alphabetSize;
+		}
+
+		if(current == nullptr){
+			return nullptr;
+		}
+
+		assert((dynamic_cast<ValueNode<Key, Value> *>(current) != nullptr));
+		return &static_cast<const ValueNode<Key, Value> *>(current)->getValue();
 	}
 
-	TailTree &operator=(const TailTree &tailTree){ // TODO check if deep copy is needed
+	Value *findIndex(const size_t tailIndex){
+		this->touchForWrite();
+
+		const TailTree &self = *this;
+		return const_cast<Value *>(self.findIndex(tailIndex));
+	}
+
+	// accumulate() for the tail given by its Key::toIndex(), builds no Key
+	bool accumulateIndex(const size_t tailIndex, const Value &value){
+		this->touchForWrite();
+		BaseNode<Key, Value> **current = this->descendIndex(tailIndex);
+
+		if(*current == nullptr){
+			*current = this->valueNodeFactory->create(value);
+			return true;
+		}
+
+		assert((dynamic_cast<ValueNode<Key, Value> *>(*current) != nullptr));
+		static_cast<ValueNode<Key, Value> *>(*current)->getValue() += value;
+		return false;
+	}
+
+	/*
+	 * Merges src into this tree, consuming it: subtrees missing here are spliced
+	 * in without copying. Every key is run through the reducer like in the dump
+	 * mergers (this tree is source 0, src is source 1) and erased if it does not
+	 * accept the result. Nodes left in src are freed.
+	 */
+	template<typename Reducer>
+	MergeStats merge(TailTree &src, const Reducer &reducer){
+		assert(this->depth == src.depth);
+
+		this->touchForWrite();
+		src.touch();
+
+		MergeStats stats;
+		if(src.isShared()){
+			// src nodes are still used by its copies, they can't be spliced
+			this->mergeCopy(this->root, src.root, reducer, stats);
+		}
+		else{
+			src.detach();
+			this->mergeMove(this->root, src.root, src, reducer, stats);
+
+			this->nodeFactory->adopt(stats.nodes);
+			this->valueNodeFactory->adopt(stats.valueNodes);
+			src.nodeFactory->release(stats.nodes);
+			src.valueNodeFactory->release(stats.valueNodes);
+		}
+
+		size_t nodes = 0;
+		size_t valueNodes = 0;
+		TailTree::countNodes(src.root, nodes, valueNodes);
+		src.clear();
+
+		src.nodeFactory->release(nodes);
+		src.valueNodeFactory->release(valueNodes);
+
+		return stats;
+	}
+
+	// merge() leaving src intact, subtrees missing here are copied
+	template<typename Reducer>
+	MergeStats mergeFrom(const TailTree &src, const Reducer &reducer){
+		assert(this->depth == src.depth);
+
+		this->touchForWrite();
+		src.touch();
+
+		MergeStats stats;
+		this->mergeCopy(this->root, src.root, reducer, stats);
+
+		return stats;
+	}
+
+	/*
+	 * Erases the tails for which predicate(key, value) is true and frees the nodes
+	 * left without tails. key is the head key, the tail symbols are appended while
+	 * walking. Returns the number of erased tails. Invalidates iterators into this tree.
+	 */
+	template<typename Predicate>
+	size_t eraseIf(Key key, Predicate predicate){
+		this->touchForWrite();
+
+		if(this->root == nullptr){
+			return 0;
+		}
+
+		size_t nodes = 0;
+		size_t valueNodes = 0;
+
+		key.reserve(key.size() + this->depth - 1);
+		TailTree::eraseIf(this->root, key, predicate, nodes, valueNodes);
+
+		this->nodeFactory->release(nodes);
+		this->valueNodeFactory->release(valueNodes);
+
+		return valueNodes;
+	}
+
+	/*
+	 * Calls visitor(key, value) for every tail in key order. key must end with
+	 * depth - 1 items that are overwritten by the tail, the items before them
+	 * (the head key) are left alone. Cheaper than iterating, builds no branch.
+	 */
+	template<typename Visitor>
+	void forEach(Key &key, Visitor &visitor) const{
+		assert(key.size() + 1 >= this->depth);
+		this->touch();
+
+		if(this->root != nullptr){
+			TailTree::forEach(this->root, key, key.size() + 1 - this->depth, visitor);
+		}
+	}
+
+public:
+	bool isEmpty() const{
+		return this->root == nullptr && this->paged == false;
+	}
+
+	// number of tails, counted by walking the tree
+	size_t size() const{
+		this->touch();
+
+		size_t nodes = 0;
+		size_t valueNodes = 0;
+		TailTree::countNodes(this->root, nodes, valueNodes);
+
+		return valueNodes;
+	}
+
+	// the non-const accessors copy a shared root first, their iterators may modify values
+	iterator begin(){
+		this->touchForWrite();
+		return this->first();
+	}
+
+	const_iterator begin() const{
+		this->touch();
+		return this->first<const_iterator>();
+	}
+
+	iterator end(){
+		return iterator();
+	}
+
+	const_iterator end() const{
+		return const_iterator();
+	}
+
+	iterator find(Key key){
+		this->touchForWrite();
+		return this->locate<iterator>(std::move(key));
+	}
+
+	const_iterator find(Key key) const{
+		this->touch();
+		return this->locate<const_iterator>(std::move(key));
+	}
+
+	// shares the nodes of tailTree like the copy constructor
+	TailTree &operator=(const TailTree &tailTree){
 		assert(this->depth == tailTree.depth);
 
-		delete this->root;
+		if(this->root == tailTree.root){
+			return *this;
+		}
 
+		std::atomic<size_t> *sharers = tailTree.share();
+
+		this->releaseRoot();
 		this->root = tailTree.root;
+		this->sharers = sharers;
 
 		return *this;
 	}
 
+	// releases the nodes, copies sharing them keep them
 	void clear(){
-		delete this->root;
-		this->root = nullptr;
+		this->releaseRoot();
+		this->paged = false;
 	}
+
+	friend class HeadsPager<Key, Value>;
+	friend class HeadsHolder<Key, Value>;
 };
 
 #endif // TAILTREE_HPP
@@ -10,6 +10,7 @@
 #include <vector>
 #include <cassert>
 #include <stdexcept>
+#include <type_traits>
 
 template<typename Key, typename Value>
 class BaseNode;
@@ -20,11 +21,15 @@ class Node;
 template<typename Key, typename Value>
 class TailTree;
 
-template<typename Key, typename Value>
+// iterator over the tails of a TailTree, the isConst one hands out const values only
+template<typename Key, typename Value, bool isConst = false>
 class TailTreeIterator{
 	Key tailKey;
 	BranchHolder<Key, Value> branch;
 
+public:
+	typedef typename std::conditional<isConst, const Value &, Value &>::type reference;
+
 protected:
 	BaseNode<Key, Value> *root() const{
 		return this->currentChain.front();
@@ -53,6 +58,9 @@ public:
 	TailTreeIterator(const TailTreeIterator &tti): tailKey(tti.tailKey), branch(tti.branch){}
 	TailTreeIterator(TailTreeIterator &&tti): tailKey(std::move(tti.tailKey)), branch(std::move(tti.branch)){}
 
+	template<bool otherIsConst, typename = typename std::enable_if<isConst && !otherIsConst>::type>
+	TailTreeIterator(const TailTreeIterator<Key, Value, otherIsConst> &tti): tailKey(tti.tailKey), branch(tti.branch){}
+
 	TailTreeIterator &operator=(const TailTreeIterator &tti){
 		this->tailKey = tti.tailKey;
 		this->branch = tti.branch;
@@ -87,7 +95,7 @@ public:
 		return this->branch.valueNode()->getValue();
 	}
 
-	Value &operator*(){
+	reference operator*(){
 		if(this->isValid() == false){
 			throw std::out_of_range("TailTreeIterator is invalid");
 		}
@@ -133,7 +141,7 @@ public:
 		}
 
 		if(success == false){
-			*this = TailTreeIterator<Key, Value>();
+			*this = TailTreeIterator();
 		}
 
 		return *this;
@@ -147,6 +155,7 @@ public:
 	}
 
 	friend class TailTree<Key, Value>;
+	friend class TailTreeIterator<Key, Value, !isConst>;
 };
 
 
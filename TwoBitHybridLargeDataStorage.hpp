@@ -0,0 +1,229 @@
+#ifndef TWOBITHYBRIDLARGEDATASTORAGE_HPP
+#define TWOBITHYBRIDLARGEDATASTORAGE_HPP
+
+#include "HybridLargeDataStorage.hpp"
+#include "IndexedHybridLargeDataStorage.hpp"
+
+#include <random>
+#include <chrono>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+template<typename Key, typename Value>
+class TwoBitHybridLargeDataStorage;
+
+/*
+ * Walks the packed keys and the side table keys as one sorted sequence.
+ * An iterator returned by find() points into one of the two parts only,
+ * incrementing it continues within that part.
+ */
+template<typename Key, typename Value>
+class TwoBitIterator{
+	typedef IndexedIterator<Key, Value, 4> PackedIterator;
+	typedef HLDSIterator<Key, Value> SideIterator;
+
+	PackedIterator packed;
+	mutable SideIterator side; // its operator* is not const
+	Key sideKey;
+	bool onSide = false;
+
+	bool packedDone() const{
+		return this->packed == PackedIterator();
+	}
+
+	bool sideDone() const{
+		return this->side == SideIterator();
+	}
+
+	void loadSideKey(){
+		if(!this->sideDone()){
+			this->sideKey = this->side.getKey();
+		}
+	}
+
+	// picks the part holding the smaller key
+	void settle(){
+		if(this->sideDone()){
+			this->onSide = false;
+			return;
+		}
+
+		if(this->packedDone()){
+			this->onSide = true;
+			return;
+		}
+
+		// packed keys never contain a side symbol, so the keys always differ
+		for(size_t i = 0; i < this->sideKey.size(); ++i){
+			const size_t packedSymbol = this->packed.symbolAt(i);
+			const size_t sideSymbol = this->sideKey[i].toIndex();
+
+			if(packedSymbol != sideSymbol){
+				this->onSide = sideSymbol < packedSymbol;
+				return;
+			}
+		}
+	}
+
+public:
+	typedef size_t						difference_type;
+	typedef Value						value_type;
+	typedef Value *						pointer;
+	typedef Value &						reference;
+	typedef std::forward_iterator_tag	iterator_category;
+
+	TwoBitIterator(){}
+
+	TwoBitIterator(PackedIterator packed, SideIterator side): packed(std::move(packed)), side(std::move(side)){
+		this->loadSideKey();
+		this->settle();
+	}
+
+	bool operator==(const TwoBitIterator &o) const{
+		const bool done = this->packedDone() && this->sideDone();
+		const bool otherDone = o.packedDone() && o.sideDone();
+
+		if(done || otherDone){
+			return done == otherDone;
+		}
+
+		if(this->onSide != o.onSide){
+			return false;
+		}
+
+		return this->onSide ? this->side == o.side : this->packed == o.packed;
+	}
+
+	bool operator!=(const TwoBitIterator &o) const{
+		return !(*this == o);
+	}
+
+	Value &operator*() const{
+		return this->onSide ? *this->side : *this->packed;
+	}
+
+	Key getKey() const{
+		return this->onSide ? this->sideKey : this->packed.getKey();
+	}
+
+	TwoBitIterator &operator++(){
+		if(this->onSide){
+			++this->side;
+			this->loadSideKey();
+		}
+		else{
+			++this->packed;
+		}
+
+		this->settle();
+		return *this;
+	}
+};
+
+/*
+ * Storage for nucleotide keys that packs ACGT-only keys with 2 bits per symbol:
+ * they go to an IndexedHybridLargeDataStorage with radix 4 (4^headSize heads,
+ * 4-way nodes, head index built by shifts). Keys with any other symbol (N)
+ * go to a small HybridLargeDataStorage side table with a single symbol head.
+ *
+ * insert/accumulate/find route by key, iteration merges both parts in key
+ * order, so dumps are the same as for HybridLargeDataStorage with the same content.
+ */
+template<typename Key, typename Value>
+class TwoBitHybridLargeDataStorage{
+	static_assert(Key::value_type::alphabetSize > 4, "alphabet fits 2 bits, use IndexedHybridLargeDataStorage");
+
+	typedef IndexedHybridLargeDataStorage<Key, Value, 4> PackedStorage;
+	typedef HybridLargeDataStorage<Key, Value> SideStorage;
+
+public:
+	typedef TwoBitIterator<Key, Value> iterator;
+
+private:
+	PackedStorage packed;
+	SideStorage sideTable;
+
+	static size_t generateRandomId(){
+		static std::default_random_engine re(std::chrono::system_clock::now().time_since_epoch().count());
+		static std::uniform_int_distribution<size_t> distr;
+
+		return distr(re);
+	}
+
+public:
+	TwoBitHybridLargeDataStorage(const size_t id, const size_t headSize, const size_t tailSize):
+		packed(id, headSize, tailSize),
+		sideTable(id, std::min<size_t>(headSize, 1), headSize + tailSize - std::min<size_t>(headSize, 1)){}
+
+	TwoBitHybridLargeDataStorage(const size_t headSize, const size_t tailSize):
+		TwoBitHybridLargeDataStorage(TwoBitHybridLargeDataStorage::generateRandomId(), headSize, tailSize){}
+
+	void clear(){
+		this->packed.clear();
+		this->sideTable.clear();
+	}
+
+	size_t keySize() const{
+		return this->packed.keySize();
+	}
+
+	size_t getId() const{
+		return this->packed.getId();
+	}
+
+	size_t getHeadSize() const{
+		return this->packed.getHeadSize();
+	}
+
+	size_t size() const{
+		return this->packed.size() + this->sideTable.size();
+	}
+
+	// number of keys stored in the side table
+	size_t sideTableSize() const{
+		return this->sideTable.size();
+	}
+
+	void insert(const Key &key, const Value &value){
+		if(PackedStorage::accepts(key)){
+			this->packed.insert(key, value);
+		}
+		else{
+			this->sideTable.insert(key, value);
+		}
+	}
+
+	// inserts the key or adds value to the stored one
+	void accumulate(const Key &key, const Value &value){
+		if(PackedStorage::accepts(key)){
+			this->packed.accumulate(key, value);
+		}
+		else{
+			this->sideTable.accumulate(key, value);
+		}
+	}
+
+	iterator find(const Key &key){
+		if(PackedStorage::accepts(key)){
+			return iterator(this->packed.find(key), typename SideStorage::iterator());
+		}
+
+		return iterator(typename PackedStorage::iterator(), this->sideTable.find(key));
+	}
+
+	iterator begin(){
+		return iterator(this->packed.begin(), this->sideTable.begin());
+	}
+
+	iterator end(){
+		return iterator();
+	}
+
+	size_t getApproximateRAMUsage() const{
+		return this->packed.getApproximateRAMUsage() + this->sideTable.getApproximateRAMUsage();
+	}
+};
+
+#endif // TWOBITHYBRIDLARGEDATASTORAGE_HPP
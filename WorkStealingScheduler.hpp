@@ -0,0 +1,178 @@
+#ifndef WORKSTEALINGSCHEDULER_HPP
+#define WORKSTEALINGSCHEDULER_HPP
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+/*
+ * Spreads the items [0, itemCount) over threadCount threads in chunks of chunkSize.
+ * Every worker owns a deque of chunks, initially an equal contiguous share, and
+ * works it from the front. A worker that runs dry steals the back half of the
+ * fullest other deque, so unevenly expensive items (heads holding most of the
+ * keys) don't leave threads idle while one is still busy.
+ *
+ * function(worker, begin, end) is called for every chunk, worker is the index
+ * of the calling thread within [0, threadCount), usable for per-thread state.
+ */
+class WorkStealingScheduler{
+	// chunks [front, back) of one worker, stolen from the back
+	struct Deque{
+		std::mutex lock;
+		size_t front = 0;
+		size_t back = 0;
+	};
+
+	const size_t threadCount;
+	const size_t chunkSize;
+
+	std::unique_ptr<Deque[]> deques;
+	std::atomic<size_t> stealCount{0};
+
+	bool popFront(const size_t worker, size_t &chunk){
+		Deque &deque = this->deques[worker];
+		std::lock_guard<std::mutex> guard(deque.lock);
+
+		if(deque.front == deque.back){
+			return false;
+		}
+
+		chunk = deque.front++;
+		return true;
+	}
+
+	// moves the back half of the fullest other deque to worker's empty deque
+	bool steal(const size_t worker){
+		while(true){
+			size_t victim = worker;
+			size_t victimSize = 0;
+
+			for(size_t i = 0; i < this->threadCount; ++i){
+				if(i == worker){
+					continue;
+				}
+
+				std::lock_guard<std::mutex> guard(this->deques[i].lock);
+				const size_t size = this->deques[i].back - this->deques[i].front;
+
+				if(size > victimSize){
+					victim = i;
+					victimSize = size;
+				}
+			}
+
+			if(victimSize == 0){
+				return false;
+			}
+
+			size_t front = 0;
+			size_t back = 0;
+			{
+				Deque &deque = this->deques[victim];
+				std::lock_guard<std::mutex> guard(deque.lock);
+
+				const size_t size = deque.back - deque.front;
+				if(size == 0){
+					continue; // emptied meanwhile, look again
+				}
+
+				back = deque.back;
+				deque.back -= (size + 1) / 2;
+				front = deque.back;
+			}
+
+			Deque &own = this->deques[worker];
+			std::lock_guard<std::mutex> guard(own.lock);
+
+			own.front = front;
+			own.back = back;
+
+			++this->stealCount;
+			return true;
+		}
+	}
+
+public:
+	WorkStealingScheduler(const size_t threadCount, const size_t chunkSize = 64):
+		threadCount(threadCount),
+		chunkSize(chunkSize),
+		deques(new Deque[threadCount])
+	{
+		if(threadCount == 0 || chunkSize == 0){
+			throw std::invalid_argument("threadCount and chunkSize must be positive");
+		}
+	}
+
+	WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+	WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+	// runs function over all items, rethrows the exception of a failed worker once all have stopped
+	template<typename Function>
+	void run(const size_t itemCount, Function function){
+		const size_t chunkCount = (itemCount + this->chunkSize - 1) / this->chunkSize;
+
+		if(this->threadCount == 1){
+			for(size_t chunk = 0; chunk < chunkCount; ++chunk){
+				function(size_t(0), chunk * this->chunkSize, std::min((chunk + 1) * this->chunkSize, itemCount));
+			}
+
+			return;
+		}
+
+		for(size_t i = 0; i < this->threadCount; ++i){
+			this->deques[i].front = chunkCount * i / this->threadCount;
+			this->deques[i].back = chunkCount * (i + 1) / this->threadCount;
+		}
+
+		std::atomic<bool> failed(false);
+		std::exception_ptr error;
+		std::mutex errorLock;
+
+		auto worker = [&](const size_t index){
+			try{
+				size_t chunk = 0;
+
+				while(!failed && (this->popFront(index, chunk) || (this->steal(index) && this->popFront(index, chunk)))){
+					function(index, chunk * this->chunkSize, std::min((chunk + 1) * this->chunkSize, itemCount));
+				}
+			}
+			catch(...){
+				std::lock_guard<std::mutex> guard(errorLock);
+				error = std::current_exception();
+				failed = true;
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for(size_t i = 1; i < this->threadCount; ++i){
+			threads.emplace_back(worker, i);
+		}
+
+		worker(0);
+
+		for(std::thread &thread : threads){
+			thread.join();
+		}
+
+		if(error){
+			std::rethrow_exception(error);
+		}
+	}
+
+	size_t getThreadCount() const{
+		return this->threadCount;
+	}
+
+	// successful steals since construction
+	size_t getStealCount() const{
+		return this->stealCount;
+	}
+};
+
+#endif // WORKSTEALINGSCHEDULER_HPP
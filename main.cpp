@@ -4,6 +4,24 @@
 #include "../FASTQParser/Common.hpp"
 #include "HLDSDump.hpp"
 #include "HLDSBinaryDumpMerger.hpp"
+#include "HLDSDumpMerger.hpp"
+#include "HLDSDumpSetOperations.hpp"
+#include "HLDSExternalCounter.hpp"
+#include "SuccinctHybridLargeDataStorage.hpp"
+#include "MinimalPerfectHashIndex.hpp"
+#include "HLDSCheckpointer.hpp"
+#include "IndexedHybridLargeDataStorage.hpp"
+#include "TwoBitHybridLargeDataStorage.hpp"
+#include "HLDSCanonicalCounter.hpp"
+#include "HLDSMinimizerBucketer.hpp"
+#include "HLDSFilteredCounter.hpp"
+#include "HLDSLayoutAdvisor.hpp"
+#include "FixedHybridLargeDataStorage.hpp"
+#include "NarrowCounterStore.hpp"
+#include "WorkStealingScheduler.hpp"
+#include "HLDSParallelDump.hpp"
+#include "HLDSBufferedDumpWriter.hpp"
+#include "HLDSPrefetchingDumpReader.hpp"
 
 #include <iostream>
 #include <list>
@@ -15,6 +33,15 @@
 #include <stdexcept>
 #include <map>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <type_traits>
+#include <mutex>
+#include <functional>
+#include <fstream>
+#include <cstdio>
+#include <limits>
+#include <sys/stat.h>
 
 
 typedef uint64_t Value;
@@ -419,8 +446,1900 @@ void mergeTest(){
 
 }
 
+void reducerMergeTest(){
+	const size_t keySize = 6;
+	const size_t headSize = 2;
+	const size_t tailSize = keySize - headSize;
+	const size_t hldsId = 42424242;
+	HybridLargeDataStorage<Key, Value> hlds1(hldsId, headSize, tailSize);
+	HybridLargeDataStorage<Key, Value> hlds2(hldsId, headSize, tailSize);
+
+	std::map<Key, Value> expected;
+
+	const size_t count = 1000;
+	for(size_t i = 0; i < count; ++i){
+		const Key key = randomKey(keySize);
+		if(expected.find(key) != expected.end()){
+			continue;
+		}
+
+		const Value value1 = i;
+		const Value value2 = count - i;
+
+		switch(i % 3){
+		case 0:
+			hlds1.insert(key, value1);
+			expected[key] = value1;
+			break;
+
+		case 1:
+			hlds2.insert(key, value2);
+			expected[key] = value2;
+			break;
+
+		case 2:
+			hlds1.insert(key, value1);
+			hlds2.insert(key, value2);
+			expected[key] = std::max(value1, value2);
+			break;
+		}
+	}
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds1);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(hlds2);
+
+	std::stringstream mergedDumps;
+	HLDSBinaryDumpMerger<Key, Value, MaxReducer<Value>> merger(dump1, dump2, mergedDumps);
+	merger.run();
+
+	HLDSDumpReader<Key, Value> reader(mergedDumps);
+	for(const auto &item : expected){
+		assert(reader.hasNext());
+		const HLDSDumpRecord<Key, Value> record = reader.read();
+		assert(record.key == item.first);
+		assert(record.value == item.second);
+	}
+
+	assert(reader.hasNext() == false);
+}
+
+void sampleMatrixMergeTest(){
+	const size_t keySize = 6;
+	const size_t headSize = 2;
+	const size_t tailSize = keySize - headSize;
+	constexpr size_t sampleCount = 3;
+
+	std::vector<std::unique_ptr<HybridLargeDataStorage<Key, Value>>> samples;
+	std::map<Key, SampleVector<uint16_t, sampleCount>> expected;
+
+	for(size_t sample = 0; sample < sampleCount; ++sample){
+		samples.emplace_back(new HybridLargeDataStorage<Key, Value>(headSize, tailSize));
+
+		std::map<Key, Value> sampleData;
+		for(size_t i = 0; i < 500; ++i){
+			sampleData[randomKey(keySize)] = (i % 2 == 0) ? i : 100000;
+		}
+
+		for(const auto &item : sampleData){
+			samples.back()->insert(item.first, item.second);
+
+			if(expected.find(item.first) == expected.end()){
+				expected[item.first].fill(0);
+			}
+			expected[item.first].at(sample) = static_cast<uint16_t>(std::min<Value>(item.second, std::numeric_limits<uint16_t>::max()));
+		}
+	}
+
+	std::vector<std::stringstream> dumps(sampleCount);
+	std::vector<std::istream *> sources;
+	for(size_t sample = 0; sample < sampleCount; ++sample){
+		HLDSDumpWriter<Key, Value>(dumps.at(sample)).dumpAll(*samples.at(sample));
+		sources.push_back(&dumps.at(sample));
+	}
+
+	typedef SampleCountReducer<Value, uint16_t, sampleCount> Reducer;
+	std::stringstream matrix;
+	HLDSDumpMerger<Key, Reducer> merger(sources, matrix);
+	merger.run();
+
+	HLDSDumpReader<Key, Reducer::OutValue> reader(matrix);
+	assert(reader.getHeader().keySize == keySize);
+
+	for(const auto &item : expected){
+		assert(reader.hasNext());
+		const HLDSDumpRecord<Key, Reducer::OutValue> record = reader.read();
+		assert(record.key == item.first);
+		assert(record.value == item.second);
+	}
+
+	assert(reader.hasNext() == false);
+}
+
+void dumpSetOperationsTest(){
+	const size_t keySize = 6;
+	const size_t headSize = 2;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> hlds1(headSize, tailSize);
+	HybridLargeDataStorage<Key, Value> hlds2(headSize, tailSize);
+
+	std::map<Key, Value> first, second;
+	for(size_t i = 0; i < 1000; ++i){
+		first[randomKey(keySize)] = 1;
+		second[randomKey(keySize)] = 2;
+	}
+
+	for(const auto &item : first){
+		hlds1.insert(item.first, item.second);
+	}
+
+	for(const auto &item : second){
+		hlds2.insert(item.first, item.second);
+	}
+
+	std::map<Key, Value> intersection, difference, symmetricDifference;
+	for(const auto &item : first){
+		if(second.find(item.first) != second.end()){
+			intersection[item.first] = item.second + second.at(item.first);
+		}
+		else{
+			difference[item.first] = item.second;
+			symmetricDifference[item.first] = item.second;
+		}
+	}
+
+	for(const auto &item : second){
+		if(first.find(item.first) == first.end()){
+			symmetricDifference[item.first] = item.second;
+		}
+	}
+
+	const std::vector<std::pair<HLDSDumpSetOperation, const std::map<Key, Value> *>> cases = {
+		{HLDSDumpSetOperation::intersection, &intersection},
+		{HLDSDumpSetOperation::difference, &difference},
+		{HLDSDumpSetOperation::symmetricDifference, &symmetricDifference}
+	};
+
+	for(const auto &testCase : cases){
+		std::stringstream dump1, dump2, result;
+		HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds1);
+		HLDSDumpWriter<Key, Value>(dump2).dumpAll(hlds2);
+
+		HLDSDumpSetOperator<Key, Value> setOperator(dump1, dump2, result, testCase.first);
+		const HLDSDumpSimilarity similarity = setOperator.run();
+
+		assert(similarity.shared == intersection.size());
+		assert(similarity.firstOnly == difference.size());
+		assert(similarity.unionSize() == intersection.size() + symmetricDifference.size());
+
+		HLDSDumpReader<Key, Value> reader(result);
+		for(const auto &item : *testCase.second){
+			assert(reader.hasNext());
+			const HLDSDumpRecord<Key, Value> record = reader.read();
+			assert(record.key == item.first);
+			assert(record.value == item.second);
+		}
+
+		assert(reader.hasNext() == false);
+	}
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds1);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(hlds1);
+	const HLDSDumpSimilarity self = HLDSDumpSetOperator<Key, Value>(dump1, dump2).run();
+	assert(self.jaccard() == 1.0);
+}
+
+void externalCounterTest(){
+	const size_t keySize = 8;
+	const size_t headSize = 3;
+	const size_t tailSize = keySize - headSize;
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < 2000; ++i){
+		keys.push_back(randomKey(keySize));
+	}
+
+	std::map<Key, Value> expected;
+	HybridLargeDataStorage<Key, Value> empty(headSize, tailSize);
+	HLDSExternalCounter<Key, Value> counter(headSize, tailSize, empty.getApproximateRAMUsage() + 16 * 1024, "externalCounterTest.run", 4);
+
+	for(size_t pass = 0; pass < 5; ++pass){
+		for(size_t i = pass; i < keys.size(); i += pass + 1){
+			counter.add(keys.at(i));
+			++expected[keys.at(i)];
+		}
+	}
+
+	assert(counter.runCount() > 4);
+
+	std::stringstream result;
+	counter.finish(result);
+	assert(counter.runCount() == 0);
+
+	HLDSDumpReader<Key, Value> reader(result);
+	for(const auto &item : expected){
+		assert(reader.hasNext());
+		const HLDSDumpRecord<Key, Value> record = reader.read();
+		assert(record.key == item.first);
+		assert(record.value == item.second);
+	}
+
+	assert(reader.hasNext() == false);
+
+	// a failing merge must not leave run files behind
+	{
+		HLDSExternalCounter<Key, Value> failing(headSize, tailSize, empty.getApproximateRAMUsage() + 16 * 1024, "externalCounterTest.failing", 2);
+		for(const Key &key : keys){
+			failing.add(key);
+		}
+		assert(failing.runCount() > 2);
+
+		std::remove("externalCounterTest.failing.0");
+
+		bool thrown = false;
+		try{
+			std::stringstream ignored;
+			failing.finish(ignored);
+		}
+		catch(const std::runtime_error &){
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	for(size_t run = 0; run < 64; ++run){
+		assert(std::ifstream("externalCounterTest.failing." + std::to_string(run)).is_open() == false);
+	}
+}
+
+void pagingTest(){
+	const size_t keySize = 10;
+	const size_t headSize = 3;
+	const size_t tailSize = keySize - headSize;
+	const size_t ramBudget = 64 * 1024;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+	hlds.enablePaging("pagingTest.spill", ramBudget);
+
+	const size_t emptySize = hlds.getApproximateRAMUsage();
+
+	std::map<Key, Value> expected;
+	for(size_t i = 0; i < 5000; ++i){
+		const Key key = randomKey(keySize);
+		hlds.accumulate(key, i);
+		expected[key] += i;
+	}
+
+	assert(hlds.size() == expected.size());
+	assert(hlds.getPager()->getEvictionCount() > 0);
+	assert(hlds.getPager()->getFaultCount() > 0);
+	assert(hlds.getApproximateRAMUsage() - emptySize <= ramBudget + keySize * sizeof(Node<Key, Value>) + sizeof(ValueNode<Key, Value>));
+
+	for(const auto &item : expected){
+		const auto it = hlds.find(item.first);
+		assert(it != hlds.end());
+		assert(*it == item.second);
+	}
+
+	auto expectedIt = expected.cbegin();
+	for(auto it = hlds.begin(); it != hlds.end(); ++it, ++expectedIt){
+		assert(expectedIt != expected.cend());
+		assert(it.getKey() == expectedIt->first);
+		assert(*it == expectedIt->second);
+	}
+	assert(expectedIt == expected.cend());
+
+	hlds.clear();
+	assert(hlds.begin() == hlds.end());
+}
+
+// --benchmark runs the tests on benchmark-sized inputs and reports their timings
+bool benchmarking = false;
+
+// n for the unit tests, benchmarkN with --benchmark
+size_t inputSize(const size_t n, const size_t benchmarkN){
+	return benchmarking ? benchmarkN : n;
+}
+
+// std::cout with --benchmark, discards the output otherwise
+std::ostream &report(){
+	static std::ostream discard(nullptr);
+	return benchmarking ? std::cout : discard;
+}
+
+template<typename Storage>
+double measureLookups(Storage &storage, const std::vector<Key> &keys, Value &checksum){
+	const auto start = std::chrono::steady_clock::now();
+
+	for(const Key &key : keys){
+		const auto it = storage.find(key);
+		if(it != storage.end()){
+			checksum += *it;
+		}
+	}
+
+	const auto finish = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(finish - start).count() / keys.size();
+}
+
+void frozenTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 8;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 100000); ++i){
+		keys.push_back(randomKey(keySize));
+		hlds.accumulate(keys.back(), i);
+	}
+
+	const FrozenHybridLargeDataStorage<Key, Value> frozen = hlds.freeze();
+	assert(frozen.size() == hlds.size());
+	assert(frozen.getId() == hlds.getId());
+
+	auto frozenIt = frozen.begin();
+	for(auto it = hlds.begin(); it != hlds.end(); ++it, ++frozenIt){
+		assert(frozenIt != frozen.end());
+		assert(frozenIt.getKey() == it.getKey());
+		assert(*frozenIt == *it);
+	}
+	assert(frozenIt == frozen.end());
+
+	for(size_t i = 0; i < 1000; ++i){
+		const Key key = randomKey(keySize);
+		const auto it = hlds.find(key);
+		const auto fit = frozen.find(key);
+		assert((it == hlds.end()) == (fit == frozen.end()));
+		if(fit != frozen.end()){
+			assert(*fit == *it);
+			assert(fit.getKey() == key);
+		}
+	}
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(frozen);
+	assert(dump1.str() == dump2.str());
+
+	HLDSDumpReader<Key, Value> reader(dump1);
+	const FrozenHybridLargeDataStorage<Key, Value> fromDump(reader, headSize);
+	assert(fromDump.size() == frozen.size());
+
+	std::shuffle(keys.begin(), keys.end(), std::default_random_engine(42));
+
+	Value checksum1 = 0, checksum2 = 0;
+	const double mutableLatency = measureLookups(hlds, keys, checksum1);
+	const double frozenLatency = measureLookups(frozen, keys, checksum2);
+	assert(checksum1 == checksum2);
+
+	report() << "frozen: RAM " << hlds.getApproximateRAMUsage() << " -> " << frozen.getApproximateRAMUsage() << " bytes, "
+			  << "lookup " << mutableLatency << " -> " << frozenLatency << " ns" << std::endl;
+}
+
+void succinctTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 50000); ++i){
+		keys.push_back(randomKey(keySize));
+		hlds.accumulate(keys.back(), i % 1000);
+	}
+
+	const SuccinctHybridLargeDataStorage<Key, Value> succinct(hlds);
+	assert(succinct.size() == hlds.size());
+
+	auto succinctIt = succinct.begin();
+	for(auto it = hlds.begin(); it != hlds.end(); ++it, ++succinctIt){
+		assert(succinctIt != succinct.end());
+		assert(succinctIt.getKey() == it.getKey());
+		assert(*succinctIt == *it);
+	}
+	assert(succinctIt == succinct.end());
+
+	for(const Key &key : keys){
+		const auto it = succinct.find(key);
+		assert(it != succinct.end());
+		assert(it.getKey() == key);
+		assert(*it == *hlds.find(key));
+	}
+
+	for(size_t i = 0; i < 1000; ++i){
+		const Key key = randomKey(keySize);
+		assert((hlds.find(key) == hlds.end()) == (succinct.find(key) == succinct.end()));
+	}
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpReader<Key, Value> reader(dump1);
+	const SuccinctHybridLargeDataStorage<Key, Value> fromDump(reader, headSize);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(fromDump);
+	assert(dump1.str().substr(HLDSDumpHeader::serializedSize()) == dump2.str().substr(HLDSDumpHeader::serializedSize()));
+
+	report() << "succinct: " << succinct.getApproximateRAMUsage() * 8.0 / succinct.size() << " bits per key" << std::endl;
+}
+
+void minimalPerfectHashTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 8;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 100000); ++i){
+		keys.push_back(randomKey(keySize));
+		hlds.accumulate(keys.back(), i % 300);
+	}
+
+	const MinimalPerfectHashIndex<Key, Value> index(hlds);
+	assert(index.size() == hlds.size());
+
+	for(const Key &key : keys){
+		Value value = 0;
+		assert(index.find(key, value));
+		assert(value == *hlds.find(key));
+	}
+
+	size_t falsePositives = 0;
+	for(size_t i = 0; i < 10000; ++i){
+		const Key key = randomKey(keySize);
+		if(hlds.find(key) == hlds.end() && index.contains(key)){
+			++falsePositives;
+		}
+	}
+	assert(falsePositives < 10);
+
+	std::shuffle(keys.begin(), keys.end(), std::default_random_engine(42));
+
+	Value checksum1 = 0, checksum2 = 0;
+	const double trieLatency = measureLookups(hlds, keys, checksum1);
+
+	const auto start = std::chrono::steady_clock::now();
+	for(const Key &key : keys){
+		checksum2 += index.valueOf(key);
+	}
+	const double indexLatency = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / keys.size();
+
+	assert(checksum1 == checksum2);
+
+	report() << "mphf: " << index.getApproximateRAMUsage() * 8.0 / index.size() << " bits per key, "
+			  << "lookup " << trieLatency << " -> " << indexLatency << " ns" << std::endl;
+}
+
+void frozenImageTest(){
+	const size_t keySize = 12;
+	const size_t headSize = 4;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+
+	for(size_t i = 0; i < 10000; ++i){
+		hlds.accumulate(randomKey(keySize), i);
+	}
+
+	const std::string path = "frozenImageTest.image";
+	hlds.freeze().save(path);
+
+	{
+		const FrozenHybridLargeDataStorage<Key, Value> mapped = FrozenHybridLargeDataStorage<Key, Value>::map(path);
+		const FrozenHybridLargeDataStorage<Key, Value> copy = mapped;
+
+		assert(mapped.getId() == hlds.getId());
+		assert(mapped.keySize() == hlds.keySize());
+		assert(mapped.size() == hlds.size());
+
+		auto mappedIt = copy.begin();
+		for(auto it = hlds.begin(); it != hlds.end(); ++it, ++mappedIt){
+			assert(mappedIt != copy.end());
+			assert(mappedIt.getKey() == it.getKey());
+			assert(*mappedIt == *it);
+
+			const auto found = mapped.find(it.getKey());
+			assert(found != mapped.end());
+			assert(*found == *it);
+		}
+		assert(mappedIt == copy.end());
+	}
+
+	std::string image;
+	{
+		std::ifstream input(path, std::ios_base::binary);
+		image.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+	}
+
+	// header: magic, version, id, headSize, tailSize, valueSize, headCount, recordCount
+	uint64_t headCount = 1;
+	for(size_t i = 0; i < headSize; ++i){
+		headCount *= Key::value_type::alphabetSize;
+	}
+
+	const auto rejects = [&](const std::string &corrupt){
+		{
+			std::ofstream output(path, std::ios_base::binary | std::ios_base::trunc);
+			output.write(corrupt.data(), corrupt.size());
+		}
+
+		try{
+			FrozenHybridLargeDataStorage<Key, Value>::map(path);
+		}
+		catch(const std::runtime_error &){
+			return true;
+		}
+
+		return false;
+	};
+	const auto patched = [&](const size_t offset, const uint64_t value){
+		std::string corrupt = image;
+		corrupt.replace(offset, sizeof(value), reinterpret_cast<const char *>(&value), sizeof(value));
+		return corrupt;
+	};
+
+	assert(rejects(image) == false);
+	assert(rejects(image.substr(0, image.size() - 1)));
+	assert(rejects(patched(3 * sizeof(uint64_t), headSize - 1)));
+	assert(rejects(patched(4 * sizeof(uint64_t), 64)));
+	assert(rejects(patched(6 * sizeof(uint64_t), headCount + (uint64_t(1) << 61)))); // (headCount + 1) * 8 wraps around
+	assert(rejects(patched(7 * sizeof(uint64_t), hlds.size() + (uint64_t(1) << 60))));
+	assert(rejects(patched(8 * sizeof(uint64_t) + headCount * sizeof(uint64_t), hlds.size() - 1)));
+
+	std::remove(path.c_str());
+
+	bool thrown = false;
+	try{
+		FrozenHybridLargeDataStorage<Key, Value>::map(path);
+	}
+	catch(std::runtime_error &){
+		thrown = true;
+	}
+	assert(thrown);
+}
+
+void checkpointTest(){
+	const size_t keySize = 10;
+	const size_t headSize = 4;
+	const size_t tailSize = keySize - headSize;
+	const std::string directory = ".";
+
+	std::map<Key, Value> expected;
+	size_t hldsId = 0;
+
+	{
+		HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+		HLDSCheckpointer<Key, Value> checkpointer(hlds, directory);
+		hldsId = hlds.getId();
+
+		for(size_t i = 0; i < 5000; ++i){
+			const Key key = randomKey(keySize);
+			hlds.accumulate(key, 1);
+			++expected[key];
+		}
+
+		assert(checkpointer.checkpoint() > 0);
+		assert(checkpointer.checkpoint() == 0);
+
+		const Key key = Key::fromString("AAAAAAAAAA");
+		hlds.accumulate(key, 7);
+		expected[key] += 7;
+		assert(checkpointer.checkpoint() == 1);
+		assert(checkpointer.getGeneration() == 3);
+
+		hlds.accumulate(Key::fromString("TTTTTTTTTT"), 1); // lost: no checkpoint after it
+	}
+
+	const HLDSCheckpointInfo info = HLDSCheckpointer<Key, Value>::peek(directory);
+	assert(info.hldsId == hldsId);
+	assert(info.headSize == headSize);
+	assert(info.tailSize == tailSize);
+
+	HybridLargeDataStorage<Key, Value> restored(info.hldsId, info.headSize, info.tailSize);
+	HLDSCheckpointer<Key, Value> checkpointer(restored, directory);
+	assert(checkpointer.getGeneration() == 3);
+	assert(restored.size() == expected.size());
+
+	auto expectedIt = expected.cbegin();
+	for(auto it = restored.begin(); it != restored.end(); ++it, ++expectedIt){
+		assert(it.getKey() == expectedIt->first);
+		assert(*it == expectedIt->second);
+	}
+	assert(expectedIt == expected.cend());
+
+	restored.clear();
+	checkpointer.checkpoint();
+	assert((HLDSCheckpointer<Key, Value>::peek(directory).generation == 4));
+
+	// a failed checkpoint leaves the checkpointer describing the previous MANIFEST
+	const Key key = Key::fromString("CCCCCCCCCC");
+	restored.accumulate(key, 1);
+	checkpointer.checkpoint();
+	restored.accumulate(key, 1);
+
+	const std::string blocked = directory + "/MANIFEST.tmp";
+	assert(::mkdir(blocked.c_str(), 0700) == 0);
+
+	bool thrown = false;
+	try{
+		checkpointer.checkpoint();
+	}
+	catch(const std::exception &){
+		thrown = true;
+	}
+	assert(thrown);
+	assert(checkpointer.getGeneration() == 5);
+
+	std::remove(blocked.c_str());
+	assert(checkpointer.checkpoint() == 1);
+	assert(checkpointer.getGeneration() == 6);
+	assert(std::ifstream(directory + "/segment.5").is_open() == false);
+
+	{
+		HybridLargeDataStorage<Key, Value> reloaded(info.hldsId, info.headSize, info.tailSize);
+		HLDSCheckpointer<Key, Value> reloader(reloaded, directory);
+		assert(reloaded.size() == 1 && *reloaded.find(key) == 2);
+	}
+
+	std::remove((directory + "/segment.6").c_str());
+	std::remove((directory + "/MANIFEST").c_str());
+}
+
+void indexedStorageTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 8;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, tailSize);
+	IndexedHybridLargeDataStorage<Key, Value> indexed(hlds.getId(), headSize, tailSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 100000); ++i){
+		keys.push_back(randomKey(keySize));
+		hlds.accumulate(keys.back(), i);
+		indexed.accumulate(keys.back(), i);
+	}
+
+	assert(indexed.size() == hlds.size());
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(indexed);
+	assert(dump1.str() == dump2.str());
+
+	for(size_t i = 0; i < 1000; ++i){
+		const Key key = randomKey(keySize);
+		assert((hlds.find(key) == hlds.end()) == (indexed.find(key) == indexed.end()));
+	}
+
+	*indexed.find(keys.front()) += 1;
+	assert(*indexed.find(keys.front()) == *hlds.find(keys.front()) + 1);
+
+	std::shuffle(keys.begin(), keys.end(), std::default_random_engine(42));
+
+	Value checksum1 = 0, checksum2 = 0;
+	const double pointerLatency = measureLookups(hlds, keys, checksum1);
+	const double indexedLatency = measureLookups(indexed, keys, checksum2);
+	assert(checksum1 + 1 == checksum2);
+
+	report() << "indexed: RAM " << hlds.getApproximateRAMUsage() << " -> " << indexed.getApproximateRAMUsage() << " bytes, "
+			  << "lookup " << pointerLatency << " -> " << indexedLatency << " ns" << std::endl;
+
+	indexed.clear();
+	assert(indexed.begin() == indexed.end());
+}
+
+void twoBitStorageTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 8;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+	TwoBitHybridLargeDataStorage<Key, Value> twoBit(hlds.getId(), headSize, keySize - headSize);
+
+	std::default_random_engine rg(42);
+	std::uniform_int_distribution<size_t> symbolDistr(0, 3);
+	std::uniform_int_distribution<size_t> nDistr(0, 50 * keySize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 100000); ++i){
+		Key key;
+		for(size_t j = 0; j < keySize; ++j){
+			key.push_back(Key::value_type::fromIndex(nDistr(rg) == 0 ? 4 : symbolDistr(rg)));
+		}
+
+		hlds.accumulate(key, i);
+		twoBit.accumulate(key, i);
+		keys.push_back(std::move(key));
+	}
+
+	assert(twoBit.size() == hlds.size());
+	assert(twoBit.sideTableSize() > 0 && twoBit.sideTableSize() < twoBit.size() / 10);
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(twoBit);
+	assert(dump1.str() == dump2.str());
+
+	for(const Key &key : keys){
+		assert(*twoBit.find(key) == *hlds.find(key));
+	}
+
+	for(size_t i = 0; i < 1000; ++i){
+		const Key key = randomKey(keySize);
+		assert((hlds.find(key) == hlds.end()) == (twoBit.find(key) == twoBit.end()));
+	}
+
+	std::shuffle(keys.begin(), keys.end(), std::default_random_engine(42));
+
+	Value checksum1 = 0, checksum2 = 0;
+	const double pointerLatency = measureLookups(hlds, keys, checksum1);
+	const double twoBitLatency = measureLookups(twoBit, keys, checksum2);
+	assert(checksum1 == checksum2);
+
+	report() << "two-bit: RAM " << hlds.getApproximateRAMUsage() << " -> " << twoBit.getApproximateRAMUsage() << " bytes, "
+			  << "lookup " << pointerLatency << " -> " << twoBitLatency << " ns, "
+			  << twoBit.sideTableSize() << " keys with N" << std::endl;
+
+	twoBit.clear();
+	assert(twoBit.size() == 0 && twoBit.begin() == twoBit.end());
+}
+
+void canonicalCounterTest(){
+	const size_t keySize = 21;
+	const size_t headSize = 8;
+	HybridLargeDataStorage<Key, Value> rolling(headSize, keySize - headSize);
+	HybridLargeDataStorage<Key, Value> naive(rolling.getId(), headSize, keySize - headSize);
+	HLDSCanonicalCounter<Key, Value> counter(rolling);
+
+	std::default_random_engine rg(7);
+	std::uniform_int_distribution<size_t> symbolDistr(0, 3);
+	std::uniform_int_distribution<size_t> nDistr(0, 500);
+
+	std::vector<Key> reads;
+	for(size_t i = 0; i < inputSize(100, 500); ++i){
+		Key read;
+		for(size_t j = 0; j < 150; ++j){
+			read.push_back(Key::value_type::fromIndex(nDistr(rg) == 0 ? 4 : symbolDistr(rg)));
+		}
+
+		reads.push_back(read);
+		reads.push_back(HLDSCanonicalCounter<Key, Value>::canonical(read)); // the other strand, or the read itself
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	size_t kmers = 0;
+	for(const Key &read : reads){
+		kmers += counter.addRead(read);
+	}
+	const double rollingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for(const Key &read : reads){
+		for(size_t i = 0; i + keySize <= read.size(); ++i){
+			Key kmer;
+			kmer.insert(kmer.end(), read.cbegin() + i, read.cbegin() + i + keySize);
+			naive.accumulate(HLDSCanonicalCounter<Key, Value>::canonical(kmer), 1);
+		}
+	}
+	const double naiveTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(kmers == reads.size() * (150 - keySize + 1));
+	assert(rolling.size() == naive.size());
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(rolling);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(naive);
+	assert(dump1.str() == dump2.str());
+
+	Key shortRead;
+	shortRead.resize(keySize - 1);
+	assert(counter.addRead(shortRead) == 0);
+
+	report() << "canonical: " << kmers << " k-mers, rolling " << rollingTime << " ms, naive " << naiveTime << " ms" << std::endl;
+}
+
+void minimizerBucketerTest(){
+	const size_t keySize = 21;
+	const size_t headSize = 8;
+	HybridLargeDataStorage<Key, Value> direct(headSize, keySize - headSize);
+	HybridLargeDataStorage<Key, Value> bucketed(direct.getId(), headSize, keySize - headSize);
+	HybridLargeDataStorage<Key, Value> parallel(direct.getId(), headSize, keySize - headSize);
+
+	std::default_random_engine rg(11);
+	std::uniform_int_distribution<size_t> symbolDistr(0, 3);
+
+	// reads at about 15x coverage of a random genome, so most k-mers repeat
+	Key genome;
+	for(size_t i = 0; i < 20000; ++i){
+		genome.push_back(Key::value_type::fromIndex(symbolDistr(rg)));
+	}
+
+	std::uniform_int_distribution<size_t> positionDistr(0, genome.size() - 150);
+	std::vector<Key> reads;
+	for(size_t i = 0; i < inputSize(300, 2000); ++i){
+		const size_t position = positionDistr(rg);
+
+		Key read;
+		read.insert(read.end(), genome.cbegin() + position, genome.cbegin() + position + 150);
+		reads.push_back(std::move(read));
+	}
+
+	HLDSCanonicalCounter<Key, Value> counter(direct);
+	auto start = std::chrono::steady_clock::now();
+	for(const Key &read : reads){
+		counter.addRead(read);
+	}
+	const double directTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	HLDSMinimizerBucketer<Key, Value> bucketer(bucketed, 9, 64);
+	start = std::chrono::steady_clock::now();
+	for(const Key &read : reads){
+		bucketer.addRead(read);
+	}
+	bucketer.flush();
+	const double bucketedTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	HLDSMinimizerBucketer<Key, Value> parallelBucketer(parallel, 9, 64, true, 4);
+	start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < reads.size(); ++i){
+		parallelBucketer.addRead(reads[i]);
+
+		if(i == reads.size() / 2){
+			parallelBucketer.flush();
+		}
+	}
+	parallelBucketer.flush();
+	const double parallelTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(bucketer.getKmerCount() == reads.size() * (150 - keySize + 1));
+	assert(bucketer.getBufferedKmerCount() == 0);
+	assert(bucketed.size() == direct.size() && parallel.size() == direct.size());
+
+	std::stringstream dump1, dump2, dump3;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(direct);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(bucketed);
+	HLDSDumpWriter<Key, Value>(dump3).dumpAll(parallel);
+	assert(dump1.str() == dump2.str());
+	assert(dump1.str() == dump3.str());
+
+	report() << "minimizer: " << static_cast<double>(bucketer.getKmerCount()) / bucketer.getSuperKmerCount() << " k-mers per super-k-mer, "
+			  << "direct " << directTime << " ms, bucketed " << bucketedTime << " ms, 4 threads " << parallelTime << " ms" << std::endl;
+
+	// head groups 0 and 1024 share a lock, moving from one to the other must not lock it twice
+	HybridLargeDataStorage<Key, Value> wrapped(headSize, keySize - headSize);
+	HLDSMinimizerBucketer<Key, Value> wrappedBucketer(wrapped, 9, 1, true, 2);
+	wrappedBucketer.addRead(Key::fromIndex(0, keySize));
+	wrappedBucketer.addRead(Key::fromIndex(65536, headSize) + Key::fromIndex(0, keySize - headSize));
+	wrappedBucketer.flush();
+	assert(wrapped.size() == 2);
+}
+
+void filteredCounterTest(){
+	const size_t keySize = 21;
+	const size_t headSize = 8;
+	HybridLargeDataStorage<Key, Value> direct(headSize, keySize - headSize);
+	HybridLargeDataStorage<Key, Value> filtered(direct.getId(), headSize, keySize - headSize);
+
+	std::default_random_engine rg(13);
+	std::uniform_int_distribution<size_t> symbolDistr(0, 3);
+	std::uniform_int_distribution<size_t> errorDistr(0, 99);
+
+	Key genome;
+	for(size_t i = 0; i < 20000; ++i){
+		genome.push_back(Key::value_type::fromIndex(symbolDistr(rg)));
+	}
+
+	// 1% substitution errors turn most distinct k-mers into singletons
+	std::uniform_int_distribution<size_t> positionDistr(0, genome.size() - 150);
+	std::vector<Key> reads;
+	for(size_t i = 0; i < inputSize(500, 3000); ++i){
+		const size_t position = positionDistr(rg);
+
+		Key read;
+		for(size_t j = position; j < position + 150; ++j){
+			read.push_back(errorDistr(rg) == 0 ? Key::value_type::fromIndex(symbolDistr(rg)) : genome[j]);
+		}
+
+		reads.push_back(std::move(read));
+	}
+
+	HLDSCanonicalCounter<Key, Value> counter(direct);
+	HLDSFilteredCounter<Key, Value> filteredCounter(filtered, 200000);
+	for(const Key &read : reads){
+		counter.addRead(read);
+		filteredCounter.addRead(read);
+	}
+
+	const size_t filteredRAM = filtered.getApproximateRAMUsage() + filteredCounter.getFilter().getApproximateRAMUsage();
+
+	filteredCounter.startCorrection();
+	for(const Key &read : reads){
+		filteredCounter.addRead(read);
+	}
+
+	size_t repeated = 0;
+	for(auto it = direct.begin(); it != direct.end(); ++it){
+		if(*it >= 2){
+			++repeated;
+			assert(*filtered.find(it.getKey()) == *it);
+		}
+	}
+
+	size_t falseSingletons = 0;
+	for(auto it = filtered.begin(); it != filtered.end(); ++it){
+		assert(*direct.find(it.getKey()) == *it);
+		falseSingletons += *it == 1 ? 1 : 0;
+	}
+
+	assert(filtered.size() == repeated + falseSingletons);
+	assert(falseSingletons < (direct.size() - repeated) / 10);
+
+	report() << "filtered: " << direct.size() << " distinct, " << repeated << " repeated, " << falseSingletons << " singletons passed, "
+			  << "RAM " << direct.getApproximateRAMUsage() << " -> " << filteredRAM << " bytes" << std::endl;
+}
+
+void layoutAdvisorTest(){
+	const size_t keySize = 20;
+	typedef HLDSLayoutAdvisor<Key, Value> Advisor;
+	HybridLargeDataStorage<Key, Value> hlds(2, keySize - 2);
+	Advisor advisor(keySize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 50000); ++i){
+		keys.push_back(randomKey(keySize));
+		hlds.accumulate(keys.back(), i);
+		advisor.add(keys.back());
+	}
+
+	const double estimate = advisor.estimateDistinct();
+	assert(std::abs(estimate - hlds.size()) < hlds.size() * 0.05);
+
+	const size_t headSize = advisor.recommendHeadSize();
+	assert(headSize > 2 && headSize < 10);
+	assert(Advisor::recommendHeadSize(keySize, 1e9) > headSize);
+
+	// the shallowest layout within 10% of the least estimated RAM
+	double minimum = std::numeric_limits<double>::max();
+	for(size_t size = 0; size < keySize; ++size){
+		minimum = std::min(minimum, Advisor::estimateRAMUsage(keySize, size, estimate, Key::value_type::alphabetSize));
+	}
+
+	assert(Advisor::estimateRAMUsage(keySize, headSize, estimate, Key::value_type::alphabetSize) <= minimum * 1.1);
+	assert(Advisor::estimateRAMUsage(keySize, headSize + 1, estimate, Key::value_type::alphabetSize) > minimum * 1.1);
+	assert(Advisor::lookupDepth(keySize, headSize) == keySize - headSize);
+
+	HybridLargeDataStorage<Key, Value> rebuilt = Advisor::rebuild(hlds, headSize);
+	assert(rebuilt.getId() == hlds.getId() && rebuilt.size() == hlds.size() && rebuilt.getHeadSize() == headSize);
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(rebuilt);
+	assert(dump1.str() == dump2.str());
+
+	// against the head 2 layout built the same way: RAM within the tolerance, fewer pointers per lookup
+	HybridLargeDataStorage<Key, Value> original = Advisor::rebuild(hlds, 2);
+	assert(rebuilt.getApproximateRAMUsage() <= original.getApproximateRAMUsage() * 1.1);
+	assert(Advisor::lookupDepth(keySize, headSize) < Advisor::lookupDepth(keySize, 2));
+
+	std::shuffle(keys.begin(), keys.end(), std::default_random_engine(42));
+
+	Value checksum1 = 0, checksum2 = 0;
+	const double originalLatency = measureLookups(original, keys, checksum1);
+	const double rebuiltLatency = measureLookups(rebuilt, keys, checksum2);
+	assert(checksum1 == checksum2);
+
+	report() << "layout: " << hlds.size() << " keys, estimated " << estimate << ", head 2 -> " << headSize << ", RAM "
+			  << original.getApproximateRAMUsage() << " -> " << rebuilt.getApproximateRAMUsage() << " bytes, "
+			  << "lookup " << originalLatency << " -> " << rebuiltLatency << " ns" << std::endl;
+
+	// moved storages keep counting their own nodes
+	HybridLargeDataStorage<Key, Value> moved(std::move(rebuilt));
+	const size_t ramBefore = moved.getApproximateRAMUsage();
+	moved.accumulate(randomKey(keySize), 1);
+	assert(moved.getApproximateRAMUsage() > ramBefore);
+	assert(moved.size() == hlds.size() + 1 || moved.size() == hlds.size());
+}
+
+template<typename Storage>
+double measureAccumulates(Storage &storage, const std::vector<Key> &keys){
+	const auto start = std::chrono::steady_clock::now();
+
+	for(size_t i = 0; i < keys.size(); ++i){
+		storage.accumulate(keys[i], i);
+	}
+
+	const auto finish = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(finish - start).count() / keys.size();
+}
+
+void fixedStorageTest(){
+	const size_t keySize = 21;
+	const size_t headSize = 8;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+	IndexedHybridLargeDataStorage<Key, Value> indexed(hlds.getId(), headSize, keySize - headSize);
+	FixedHybridLargeDataStorage<Key, Value, keySize, headSize> fixed(hlds.getId());
+
+	static_assert(FixedHybridLargeDataStorage<Key, Value, keySize, headSize>::headCount == 390625, "5^8 heads");
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(5000, 100000); ++i){
+		keys.push_back(randomKey(keySize));
+	}
+
+	const double hldsInsert = measureAccumulates(hlds, keys);
+	const double indexedInsert = measureAccumulates(indexed, keys);
+	const double fixedInsert = measureAccumulates(fixed, keys);
+
+	assert(fixed.size() == hlds.size());
+
+	std::stringstream dump1, dump2;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(fixed);
+	assert(dump1.str() == dump2.str());
+
+	const Key extra = randomKey(keySize);
+	fixed.accumulateIndex(extra.toIndex(), 5);
+	fixed.accumulateIndex(extra.toIndex(), 2);
+	assert(*fixed.find(extra) == 7 && *fixed.findValueByIndex(extra.toIndex()) == 7);
+
+	std::shuffle(keys.begin(), keys.end(), std::default_random_engine(42));
+
+	Value checksum1 = 0, checksum2 = 0, checksum3 = 0;
+	const double hldsLookup = measureLookups(hlds, keys, checksum1);
+	const double indexedLookup = measureLookups(indexed, keys, checksum2);
+	const double fixedLookup = measureLookups(fixed, keys, checksum3);
+	assert(checksum1 == checksum2 && checksum1 == checksum3);
+
+	report() << "fixed: accumulate " << hldsInsert << " / " << indexedInsert << " / " << fixedInsert << " ns, "
+			  << "lookup " << hldsLookup << " / " << indexedLookup << " / " << fixedLookup << " ns (runtime / indexed / fixed)" << std::endl;
+
+	fixed.clear();
+	assert(fixed.size() == 0 && fixed.begin() == fixed.end());
+}
+
+void narrowCounterTest(){
+	const size_t keySize = 21;
+	const size_t headSize = 8;
+	typedef NarrowCounterStore<Value, uint8_t> Counters;
+
+	FixedHybridLargeDataStorage<Key, Value, keySize, headSize> wide(1);
+	FixedHybridLargeDataStorage<Key, Value, keySize, headSize, Counters> narrow(1);
+	IndexedHybridLargeDataStorage<Key, Value, Key::value_type::alphabetSize, Counters> indexed(1, headSize, keySize - headSize);
+
+	std::default_random_engine rg(17);
+	std::geometric_distribution<Value> countDistr(0.2);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(20000, 200000); ++i){
+		keys.push_back(randomKey(keySize));
+
+		// a few counts cross the 8-bit range, some only after several additions
+		const Value count = i % 1000 == 0 ? 100000 + i : countDistr(rg) + 1;
+		for(size_t part = 0; part < (i % 3000 == 1 ? 300 : 1); ++part){
+			wide.accumulate(keys.back(), count);
+			narrow.accumulate(keys.back(), count);
+			indexed.accumulate(keys.back(), count);
+		}
+	}
+
+	std::stringstream dump1, dump2, dump3;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(wide);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(narrow);
+	HLDSDumpWriter<Key, Value>(dump3).dumpAll(indexed);
+	assert(dump1.str() == dump2.str());
+	assert(dump1.str() == dump3.str());
+
+	// escalated values go back to narrow counters when they shrink
+	auto it = narrow.find(keys.front());
+	assert(*it == 100000);
+	*it = 3;
+	*it += 250;
+	assert(*it == 253 && *narrow.find(keys.front()) == 253);
+	*it += 1000;
+	assert(*narrow.find(keys.front()) == 1253);
+
+	report() << "narrow counters: RAM " << wide.getApproximateRAMUsage() << " -> " << narrow.getApproximateRAMUsage() << " bytes" << std::endl;
+}
+
+void pruneTest(){
+	const size_t keySize = 21;
+	const size_t headSize = 8;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+	HybridLargeDataStorage<Key, Value> serial(hlds.getId(), headSize, keySize - headSize);
+	HybridLargeDataStorage<Key, Value> expected(hlds.getId(), headSize, keySize - headSize);
+
+	std::default_random_engine rg(19);
+	std::geometric_distribution<Value> countDistr(0.5);
+
+	for(size_t i = 0; i < inputSize(10000, 100000); ++i){
+		const Key key = randomKey(keySize);
+		const Value count = countDistr(rg) + 1;
+
+		hlds.accumulate(key, count);
+		serial.accumulate(key, count);
+	}
+
+	for(auto it = hlds.begin(); it != hlds.end(); ++it){
+		if(*it >= 3){
+			expected.insert(it.getKey(), *it);
+		}
+	}
+
+	const size_t ramBefore = hlds.getApproximateRAMUsage();
+	const size_t sizeBefore = hlds.size();
+
+	const auto start = std::chrono::steady_clock::now();
+	const size_t erased = hlds.pruneBelow(3, 4);
+	const double pruneTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(serial.pruneBelow(3) == erased);
+	assert(erased + expected.size() == sizeBefore);
+	assert(hlds.size() == expected.size() && serial.size() == expected.size());
+
+	// freed nodes are gone from the accounting: same RAM as building the survivors from scratch
+	assert(hlds.getApproximateRAMUsage() == expected.getApproximateRAMUsage());
+	assert(serial.getApproximateRAMUsage() == expected.getApproximateRAMUsage());
+
+	std::stringstream dump1, dump2, dump3;
+	HLDSDumpWriter<Key, Value>(dump1).dumpAll(hlds);
+	HLDSDumpWriter<Key, Value>(dump2).dumpAll(serial);
+	HLDSDumpWriter<Key, Value>(dump3).dumpAll(expected);
+	assert(dump1.str() == dump3.str() && dump2.str() == dump3.str());
+
+	// key predicates see the whole key
+	const Key::value_type a = Key::value_type::fromIndex(0);
+	hlds.eraseIf([a](const Key &key, const Value &){
+		return key[keySize - 1] == a;
+	});
+
+	for(auto it = hlds.begin(); it != hlds.end(); ++it){
+		assert(it.getKey()[keySize - 1] != a);
+	}
+
+	// paged heads are faulted in before pruning
+	expected.enablePaging("pruneTest.spill", expected.getApproximateRAMUsage() / 4);
+	for(auto it = serial.begin(); it != serial.end(); ++it){
+		*expected.find(it.getKey()) += 0;
+	}
+	expected.pruneBelow(5);
+
+	for(auto it = serial.begin(); it != serial.end(); ++it){
+		assert((expected.find(it.getKey()) == expected.end()) == (*it < 5));
+	}
+
+	report() << "prune: " << erased << " of " << sizeBefore << " keys erased in " << pruneTime << " ms, RAM "
+			  << ramBefore << " -> " << serial.getApproximateRAMUsage() << " bytes" << std::endl;
+}
+
+// drops keys whose merged count is odd
+class EvenSumReducer : public SumReducer<Value>{
+public:
+	bool accept(const Value &accumulator) const{
+		return accumulator % 2 == 0;
+	}
+};
+
+void inMemoryMergeTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	const size_t tailSize = keySize - headSize;
+	HybridLargeDataStorage<Key, Value> first(headSize, tailSize);
+	HybridLargeDataStorage<Key, Value> second(first.getId(), headSize, tailSize);
+	HybridLargeDataStorage<Key, Value> expected(first.getId(), headSize, tailSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(6000, 60000); ++i){
+		keys.push_back(randomKey(keySize));
+	}
+
+	for(size_t i = 0; i < keys.size(); ++i){
+		if(i % 3 != 2){
+			first.accumulate(keys[i], i);
+			expected.accumulate(keys[i], i);
+		}
+
+		if(i % 3 != 0){
+			second.accumulate(keys[i], i + 1);
+			expected.accumulate(keys[i], i + 1);
+		}
+	}
+
+	std::stringstream expectedDump;
+	HLDSDumpWriter<Key, Value>(expectedDump).dumpAll(expected);
+
+	HybridLargeDataStorage<Key, Value> copied(first.getId(), headSize, tailSize);
+	copied.mergeFrom(first);
+	copied.mergeFrom(second);
+	assert(copied.size() == expected.size());
+	assert(copied.getApproximateRAMUsage() == expected.getApproximateRAMUsage());
+
+	std::stringstream copiedDump;
+	HLDSDumpWriter<Key, Value>(copiedDump).dumpAll(copied);
+	assert(copiedDump.str() == expectedDump.str());
+
+	// odd sums are rejected and erased, keys of one side only included
+	HybridLargeDataStorage<Key, Value> filtered(first.getId(), headSize, tailSize);
+	filtered.mergeFrom(first);
+	filtered.mergeFrom(second, EvenSumReducer());
+
+	for(size_t i = 0; i < keys.size(); ++i){
+		const bool present = filtered.find(keys[i]) != filtered.end();
+		assert((present == (*expected.find(keys[i]) % 2 == 0)));
+	}
+
+	// both merge paths keep what HLDSBinaryDumpMerger writes for the same reducer
+	const ThresholdedSumReducer<Value> thresholded(keys.size() / 2);
+	std::stringstream firstDump, secondDump, thresholdedDump;
+	HLDSDumpWriter<Key, Value>(firstDump).dumpAll(first);
+	HLDSDumpWriter<Key, Value>(secondDump).dumpAll(second);
+	HLDSBinaryDumpMerger<Key, Value, ThresholdedSumReducer<Value>>(firstDump, secondDump, thresholdedDump, thresholded).run();
+
+	HybridLargeDataStorage<Key, Value> rebuilt(first.getId(), headSize, tailSize);
+	for(HLDSDumpReader<Key, Value> reader(thresholdedDump); reader.hasNext();){
+		const HLDSDumpRecord<Key, Value> record = reader.read();
+		rebuilt.insert(record.key, record.value);
+	}
+
+	HybridLargeDataStorage<Key, Value> reducedCopy(first);
+	reducedCopy.mergeFrom(second, thresholded);
+
+	HybridLargeDataStorage<Key, Value> secondCopy(first.getId(), headSize, tailSize);
+	secondCopy.mergeFrom(second);
+	HybridLargeDataStorage<Key, Value> reducedMove(first);
+	reducedMove.merge(std::move(secondCopy), thresholded);
+
+	assert((secondCopy.size() == 0 && secondCopy.getApproximateRAMUsage() == HybridLargeDataStorage<Key, Value>(headSize, tailSize).getApproximateRAMUsage()));
+
+	for(const HybridLargeDataStorage<Key, Value> *reduced : {&reducedCopy, &reducedMove}){
+		assert(reduced->size() == rebuilt.size());
+		assert(reduced->getApproximateRAMUsage() == rebuilt.getApproximateRAMUsage());
+
+		std::stringstream reducedDump;
+		HLDSDumpWriter<Key, Value>(reducedDump).dumpAll(*reduced);
+		assert(reducedDump.str() == thresholdedDump.str());
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	first.merge(std::move(second), SumReducer<Value>(), 4);
+	const double mergeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(second.size() == 0 && second.begin() == second.end());
+	assert((second.getApproximateRAMUsage() == HybridLargeDataStorage<Key, Value>(headSize, tailSize).getApproximateRAMUsage()));
+	assert(first.size() == expected.size());
+	assert(first.getApproximateRAMUsage() == expected.getApproximateRAMUsage());
+
+	std::stringstream movedDump;
+	HLDSDumpWriter<Key, Value>(movedDump).dumpAll(first);
+	assert(movedDump.str() == expectedDump.str());
+
+	report() << "in-memory merge: " << first.size() << " keys, splicing merge " << mergeTime << " ms" << std::endl;
+}
+
+
+void snapshotTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(10000, 100000); ++i){
+		keys.push_back(randomKey(keySize));
+	}
+
+	for(size_t i = 0; i < keys.size() / 2; ++i){
+		hlds.insert(keys[i], i);
+	}
+
+	const size_t ramUsage = hlds.getApproximateRAMUsage();
+
+	auto start = std::chrono::steady_clock::now();
+	const HybridLargeDataStorage<Key, Value> snapshot = hlds.snapshot();
+	const double snapshotTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(snapshot.size() == hlds.size());
+	assert(snapshot.getApproximateRAMUsage() == ramUsage);
+
+	// ingest goes on while the snapshot is queried
+	start = std::chrono::steady_clock::now();
+	std::thread writer([&](){
+		for(size_t i = 0; i < keys.size(); ++i){
+			hlds.accumulate(keys[i], 1000);
+		}
+	});
+
+	size_t lookups = 0;
+	for(size_t round = 0; round < 4; ++round){
+		for(size_t i = 0; i < keys.size() / 2; ++i, ++lookups){
+			const Value *value = snapshot.findValueByIndex(keys[i].toIndex());
+			assert(value != nullptr && *value == i);
+		}
+	}
+
+	writer.join();
+	const double ingestTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(snapshot.size() == keys.size() / 2);
+	assert(snapshot.getApproximateRAMUsage() == ramUsage);
+	assert(hlds.size() == keys.size());
+
+	for(size_t i = 0; i < keys.size(); ++i){
+		assert(*hlds.find(keys[i]) == (i < keys.size() / 2 ? i + 1000 : 1000));
+
+		if(i >= keys.size() / 2){
+			assert(snapshot.findValueByIndex(keys[i].toIndex()) == nullptr);
+		}
+	}
+
+	// writes to a copy stay in the copy, clearing the original keeps the copy intact
+	HybridLargeDataStorage<Key, Value> copy(hlds);
+	copy.accumulate(keys[0], 1);
+	assert(*hlds.find(keys[0]) == 1000);
+	assert(*copy.find(keys[0]) == 1001);
+
+	// writes through find() and begin() of a copy stay in the copy as well
+	const Key firstKey = hlds.begin().getKey();
+	const Value firstValue = *hlds.begin();
+	const Value value = *hlds.find(keys[2]);
+	HybridLargeDataStorage<Key, Value> written(hlds);
+	*written.find(keys[2]) += 1;
+	*written.begin() += 1;
+	assert(*hlds.findValueByIndex(keys[2].toIndex()) == value);
+	assert(*hlds.findValueByIndex(firstKey.toIndex()) == firstValue);
+	assert(*written.find(keys[2]) == value + (keys[2] == firstKey ? 2 : 1));
+
+	// dumping an instance that shares its heads reads them in place, a copy would move the values
+	const HybridLargeDataStorage<Key, Value> &shared = hlds;
+	std::vector<const Value *> values;
+	for(size_t i = 1; i < 100; ++i){
+		values.push_back(shared.findValueByIndex(keys[i].toIndex()));
+	}
+
+	std::stringstream dump;
+	HLDSDumpWriter<Key, Value>(dump).dumpAll(hlds);
+
+	for(size_t i = 1; i < 100; ++i){
+		assert(shared.findValueByIndex(keys[i].toIndex()) == values[i - 1]);
+	}
+
+	HLDSDumpReader<Key, Value> reader(dump);
+	for(auto it = hlds.cbegin(); it != hlds.cend(); ++it){
+		const HLDSDumpRecord<Key, Value> record = reader.read();
+		assert(record.key == it.getKey() && record.value == *it);
+	}
+
+	assert(reader.hasNext() == false);
+
+	hlds.clear();
+	assert(copy.size() == keys.size());
+	assert(*copy.find(keys[1]) == 1001);
+
+	HybridLargeDataStorage<Key, Value> paged(headSize, keySize - headSize);
+	paged.enablePaging("snapshotTest.spill", ramUsage / 4);
+
+	bool thrown = false;
+	try{
+		paged.snapshot();
+	}
+	catch(std::logic_error &){
+		thrown = true;
+	}
+
+	assert(thrown);
+
+	report() << "snapshot: " << snapshotTime << " ms, " << lookups << " snapshot lookups during ingest of " << keys.size() << " keys in " << ingestTime << " ms" << std::endl;
+}
+
+
+void concurrentReadTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < inputSize(10000, 200000); ++i){
+		keys.push_back(randomKey(keySize));
+		hlds.accumulate(keys.back(), i);
+	}
+
+	const HybridLargeDataStorage<Key, Value> &view = hlds;
+
+	static_assert(std::is_same<decltype(*view.cbegin()), const Value &>::value, "const iterators must not hand out mutable values");
+	static_assert(std::is_same<decltype(*view.find(keys[0])), const Value &>::value, "const find must not hand out mutable values");
+
+	assert(view == hlds);
+	assert(std::equal(view.cbegin(), view.cend(), hlds.begin()));
+
+	for(size_t i = 0; i < 1000; ++i){
+		assert(view.contains(keys[i]) && view.count(keys[i]) == 1);
+
+		const Key missing = randomKey(keySize);
+		assert(view.contains(missing) == (hlds.find(missing) != hlds.end()));
+		assert(view.count(missing) == (view.contains(missing) ? 1 : 0));
+	}
+
+	// writes through the mutable iterators of a copy stay in the copy
+	HybridLargeDataStorage<Key, Value> copy(hlds);
+	const Value original = *view.find(keys[0]);
+	*copy.find(keys[0]) = original + 1;
+	*copy.begin() += 1;
+	assert(*view.find(keys[0]) == original);
+	assert(*copy.find(keys[0]) == original + 1);
+	assert(view != copy);
+
+	std::vector<size_t> order(keys.size());
+	for(size_t i = 0; i < order.size(); ++i){
+		order[i] = (i * 7919) % keys.size();
+	}
+
+	double singleThreadTime = 0.0;
+	report() << "concurrent lookups of " << keys.size() << " keys:";
+
+	for(size_t threadCount = 1; threadCount <= 8; threadCount *= 2){
+		std::atomic<size_t> found(0);
+
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for(size_t t = 0; t < threadCount; ++t){
+			threads.emplace_back([&, t](){
+				size_t localFound = 0;
+
+				for(size_t i = t; i < order.size(); i += threadCount){
+					localFound += view.count(keys[order[i]]);
+				}
+
+				found += localFound;
+			});
+		}
+
+		for(std::thread &thread : threads){
+			thread.join();
+		}
+
+		const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		assert(found == keys.size());
+
+		if(threadCount == 1){
+			singleThreadTime = time;
+		}
+
+		report() << " " << threadCount << " threads " << time << " ms (x" << singleThreadTime / time << ")";
+	}
+
+	report() << ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+}
+
+
+void parallelScanTest(){
+	// every item is visited once however uneven the chunks are
+	{
+		WorkStealingScheduler scheduler(4, 8);
+		std::vector<std::atomic<size_t>> visits(10000);
+		for(std::atomic<size_t> &visit : visits){
+			visit = 0;
+		}
+
+		scheduler.run(visits.size(), [&](const size_t worker, const size_t begin, const size_t end){
+			assert(worker < 4 && begin < end && end <= visits.size());
+
+			for(size_t i = begin; i < end; ++i){
+				++visits[i];
+
+				if(i < 1000){
+					std::this_thread::sleep_for(std::chrono::microseconds(20)); // the first worker's share is slow
+				}
+			}
+		});
+
+		for(const std::atomic<size_t> &visit : visits){
+			assert(visit == 1);
+		}
+
+		assert(scheduler.getStealCount() > 0);
+
+		bool thrown = false;
+		try{
+			scheduler.run(visits.size(), [](const size_t, const size_t begin, const size_t){
+				if(begin == 800){
+					throw std::runtime_error("visitor failed");
+				}
+			});
+		}
+		catch(std::runtime_error &){
+			thrown = true;
+		}
+
+		assert(thrown);
+	}
+
+	// most keys share a few heads
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+
+	Key prefix = randomKey(3);
+	for(size_t i = 0; i < inputSize(20000, 300000); ++i){
+		Key key = randomKey(keySize);
+		if(i % 4 != 0){
+			std::copy(prefix.cbegin(), prefix.cend(), key.begin());
+		}
+
+		hlds.accumulate(key, i % 100);
+	}
+
+	Value expectedSum = 0;
+	Value expectedMax = 0;
+	std::map<Value, size_t> expectedHistogram;
+
+	auto start = std::chrono::steady_clock::now();
+	for(auto it = hlds.cbegin(); it != hlds.cend(); ++it){
+		expectedSum += *it;
+	}
+	const double iteratorTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	for(auto it = hlds.cbegin(); it != hlds.cend(); ++it){
+		expectedMax = std::max(expectedMax, *it);
+		++expectedHistogram[*it];
+	}
+
+	report() << "parallel scan of " << hlds.size() << " keys: iterator " << iteratorTime << " ms";
+
+	for(size_t threadCount = 1; threadCount <= 4; threadCount *= 2){
+		start = std::chrono::steady_clock::now();
+		const Value sum = hlds.parallelReduce(Value(0), [](const Key &, const Value &value){
+			return value;
+		}, std::plus<Value>(), threadCount);
+		const double reduceTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		assert(sum == expectedSum);
+		report() << ", reduce on " << threadCount << " threads " << reduceTime << " ms";
+
+		const Value max = hlds.parallelReduce(Value(0), [](const Key &, const Value &value){
+			return value;
+		}, [](const Value a, const Value b){
+			return std::max(a, b);
+		}, threadCount);
+
+		assert(max == expectedMax);
+
+		std::mutex histogramLock;
+		std::map<Value, size_t> histogram;
+		std::atomic<size_t> visited(0);
+		Key previous;
+
+		hlds.parallelForEach([&](const Key &key, const Value &value){
+			assert(key.size() == keySize);
+			assert(*hlds.find(key) == value);
+
+			std::lock_guard<std::mutex> guard(histogramLock);
+			++histogram[value];
+			++visited;
+		}, threadCount);
+
+		assert(visited == hlds.size());
+		assert(histogram == expectedHistogram);
+	}
+
+	report() << std::endl;
+}
+
+
+std::string readFile(const std::string &path){
+	std::ifstream in(path, std::ios_base::binary);
+	std::stringstream content;
+	content << in.rdbuf();
+
+	return content.str();
+}
+
+void parallelDumpTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+
+	Key prefix = randomKey(2);
+	for(size_t i = 0; i < inputSize(20000, 300000); ++i){
+		Key key = randomKey(keySize);
+		if(i % 2 != 0){
+			std::copy(prefix.cbegin(), prefix.cend(), key.begin());
+		}
+
+		hlds.accumulate(key, i);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::ofstream out("parallelDumpTest.sequential", std::ios_base::binary | std::ios_base::trunc);
+		HLDSDumpWriter<Key, Value>(out).dumpAll(hlds);
+	}
+	const double sequentialTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	const std::string expected = readFile("parallelDumpTest.sequential");
+
+	const size_t recordSize = HLDSDumpRecord<Key, Value>::serializedSize(keySize);
+	const HLDSParallelDumpWriter<Key, Value> writer(hlds, 4, 10);
+
+	start = std::chrono::steady_clock::now();
+	const HLDSDumpManifest single = writer.dumpSingleFile("parallelDumpTest.single");
+	const double singleTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	assert(readFile("parallelDumpTest.single") == expected);
+	assert(single.singleFile && single.ranges.size() == 10 && single.recordCount() == hlds.size());
+
+	start = std::chrono::steady_clock::now();
+	const HLDSDumpManifest segmented = writer.dumpSegments("parallelDumpTest.segment");
+	const double segmentsTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const HLDSDumpManifest manifest = HLDSDumpManifest::read("parallelDumpTest.segment");
+	assert(manifest.singleFile == false && manifest.hldsId == hlds.getId() && manifest.keySize == keySize && manifest.headSize == headSize);
+	assert(manifest.ranges.size() == segmented.ranges.size());
+
+	// ranges cover the heads in order and read back independently
+	std::string records;
+	uint64_t nextHead = 0;
+	size_t largest = 0;
+
+	for(size_t i = 0; i < manifest.ranges.size(); ++i){
+		const HLDSDumpRange &range = manifest.ranges[i];
+		assert(range.firstHead == nextHead && range.endHead >= range.firstHead);
+		nextHead = range.endHead;
+		largest = std::max(largest, static_cast<size_t>(range.recordCount));
+
+		const std::string segment = readFile(manifest.rangePath("parallelDumpTest.segment", i));
+		assert(segment.size() == HLDSDumpHeader::serializedSize() + range.recordCount * recordSize);
+		records += segment.substr(range.offset);
+
+		std::ifstream in(single.rangePath("parallelDumpTest.single", i), std::ios_base::binary);
+		in.seekg(single.ranges[i].offset);
+		for(uint64_t record = 0; record < single.ranges[i].recordCount; ++record){
+			const HLDSDumpRecord<Key, Value> read = HLDSDumpRecord<Key, Value>::fromStream(in, keySize);
+			assert(read.key.size() == keySize && *hlds.find(read.key) == read.value);
+		}
+	}
+
+	assert(nextHead == hlds.getHeadCount());
+	assert(records == expected.substr(HLDSDumpHeader::serializedSize()));
+
+	std::ifstream firstSegment(manifest.rangePath("parallelDumpTest.segment", 0), std::ios_base::binary);
+	HLDSDumpReader<Key, Value> reader(firstSegment);
+	assert(reader.getHeader().hldsId == hlds.getId() && reader.hasNext() == (manifest.ranges[0].recordCount != 0));
+
+	report() << "parallel dump of " << hlds.size() << " keys: dumpAll " << sequentialTime << " ms, single file " << singleTime << " ms, segments " << segmentsTime << " ms, largest range " << largest << " records" << std::endl;
+
+	for(size_t i = 0; i < manifest.ranges.size(); ++i){
+		std::remove(manifest.rangePath("parallelDumpTest.segment", i).c_str());
+	}
+
+	std::remove(HLDSDumpManifest::manifestPath("parallelDumpTest.segment").c_str());
+	std::remove(HLDSDumpManifest::manifestPath("parallelDumpTest.single").c_str());
+	std::remove("parallelDumpTest.single");
+	std::remove("parallelDumpTest.sequential");
+}
+
+
+void bufferedDumpTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+
+	for(size_t i = 0; i < inputSize(20000, 500000); ++i){
+		hlds.accumulate(randomKey(keySize), i);
+	}
+
+	const double megabytes = (HLDSDumpHeader::serializedSize() + hlds.size() * HLDSDumpRecord<Key, Value>::serializedSize(keySize)) / 1048576.0;
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::ofstream out("bufferedDumpTest.plain", std::ios_base::binary | std::ios_base::trunc);
+		HLDSDumpWriter<Key, Value>(out).dumpAll(hlds);
+	}
+	const double plainTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	size_t bytesWritten = 0;
+	{
+		std::ofstream out("bufferedDumpTest.buffered", std::ios_base::binary | std::ios_base::trunc);
+		HLDSBufferedDumpWriter<Key, Value> writer(out);
+		writer.dumpAll(hlds);
+		writer.close();
+		bytesWritten = writer.getBytesWritten();
+	}
+	const double bufferedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const std::string expected = readFile("bufferedDumpTest.plain");
+	assert(readFile("bufferedDumpTest.buffered") == expected);
+	assert(bytesWritten == expected.size());
+
+	// the iterator path with buffers smaller than the dump
+	const FrozenHybridLargeDataStorage<Key, Value> frozen = hlds.freeze();
+	std::stringstream small;
+	{
+		HLDSBufferedDumpWriter<Key, Value> writer(small, 4096 + 7);
+		writer.dumpAll(frozen);
+	}
+
+	std::stringstream frozenExpected;
+	HLDSDumpWriter<Key, Value>(frozenExpected).dumpAll(frozen);
+	assert(small.str() == frozenExpected.str());
+
+	// a closed writer refuses more records
+	std::stringstream closed;
+	HLDSBufferedDumpWriter<Key, Value> writer(closed, 4096);
+	writer.writeHeader(HLDSDumpHeader(hlds.getId(), keySize));
+	writer.close();
+
+	bool thrown = false;
+	try{
+		writer.write(randomKey(keySize), 1);
+	}
+	catch(std::logic_error &){
+		thrown = true;
+	}
+
+	assert(thrown);
+	assert(writer.getBytesWritten() == HLDSDumpHeader::serializedSize());
+
+	// the exception mask of the stream is the caller's again
+	assert(closed.exceptions() == std::ios_base::goodbit);
+
+	// writers alone, without walking the storage
+	std::vector<HLDSDumpRecord<Key, Value>> records;
+	hlds.parallelForEach([&records](const Key &key, const Value &value){
+		records.emplace_back(key, value);
+	});
+
+	start = std::chrono::steady_clock::now();
+	{
+		std::ofstream out("bufferedDumpTest.plain", std::ios_base::binary | std::ios_base::trunc);
+		HLDSDumpWriter<Key, Value> plainWriter(out);
+		plainWriter.writeHeader(HLDSDumpHeader(hlds.getId(), keySize));
+
+		for(const HLDSDumpRecord<Key, Value> &record : records){
+			plainWriter.write(record);
+		}
+	}
+	const double plainWriteTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	{
+		std::ofstream out("bufferedDumpTest.buffered", std::ios_base::binary | std::ios_base::trunc);
+		HLDSBufferedDumpWriter<Key, Value> bufferedWriter(out);
+		bufferedWriter.writeHeader(HLDSDumpHeader(hlds.getId(), keySize));
+
+		for(const HLDSDumpRecord<Key, Value> &record : records){
+			bufferedWriter.write(record);
+		}
+
+		bufferedWriter.close();
+	}
+	const double bufferedWriteTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	assert(readFile("bufferedDumpTest.buffered") == expected);
+
+	report() << "dump of " << megabytes << " MiB: dumpAll " << megabytes / plainTime << " -> " << megabytes / bufferedTime << " MiB/s, ";
+	report() << "records only " << megabytes / plainWriteTime << " -> " << megabytes / bufferedWriteTime << " MiB/s" << std::endl;
+
+	std::remove("bufferedDumpTest.plain");
+	std::remove("bufferedDumpTest.buffered");
+}
+
+void prefetchingReaderTest(){
+	const size_t keySize = 20;
+	const size_t headSize = 6;
+	const size_t dumpCount = 4;
+
+	// snapshots of one growing instance, HLDSBinaryDumpMerger wants dumps of the same storage
+	HybridLargeDataStorage<Key, Value> hlds(headSize, keySize - headSize);
+	std::vector<std::string> paths;
+	for(size_t dump = 0; dump < dumpCount; ++dump){
+		for(size_t i = 0; i < inputSize(5000, 100000); ++i){
+			hlds.accumulate(randomKey(keySize), i % 7 + 1);
+		}
+
+		paths.push_back("prefetchingReaderTest." + std::to_string(dump));
+		std::ofstream out(paths.back(), std::ios_base::binary | std::ios_base::trunc);
+		HLDSDumpWriter<Key, Value>(out).dumpAll(hlds);
+	}
+
+	// same records as HLDSDumpReader, also with blocks smaller than a record and a ragged last block
+	for(const size_t bufferSize : {size_t(1), size_t(4096), size_t(1) << 20}){
+		for(const size_t depth : {size_t(1), size_t(3)}){
+			std::ifstream plainIn(paths.front(), std::ios_base::binary);
+			std::ifstream prefetchingIn(paths.front(), std::ios_base::binary);
+
+			HLDSDumpReader<Key, Value> plain(plainIn);
+			HLDSPrefetchingDumpReader<Key, Value> prefetching(prefetchingIn, bufferSize, depth);
+			assert(prefetching.getHeader().hldsId == plain.getHeader().hldsId);
+			assert(prefetching.getHeader().keySize == plain.getHeader().keySize);
+
+			while(plain.hasNext()){
+				assert(prefetching.hasNext());
+				assert(prefetching.peek().key == plain.peek().key);
+
+				const HLDSDumpRecord<Key, Value> record = prefetching.read();
+				const HLDSDumpRecord<Key, Value> expected = plain.read();
+				assert(record.key == expected.key);
+				assert(record.value == expected.value);
+			}
+
+			assert(prefetching.hasNext() == false);
+		}
+	}
+
+	// a truncated last record ends the dump, an unread reader stops its thread
+	{
+		std::stringstream truncated(readFile(paths.front()));
+		truncated.str(truncated.str().substr(0, truncated.str().size() - 1));
+
+		HLDSDumpReader<Key, Value> plain(truncated);
+		size_t plainCount = 0;
+		for(; plain.hasNext(); plain.read()){
+			++plainCount;
+		}
+
+		truncated.clear();
+		truncated.seekg(0);
+
+		HLDSPrefetchingDumpReader<Key, Value> prefetching(truncated, 4096);
+		size_t prefetchingCount = 0;
+		for(; prefetching.hasNext(); prefetching.read()){
+			++prefetchingCount;
+		}
+
+		assert(prefetchingCount == plainCount);
+
+		std::ifstream in(paths.back(), std::ios_base::binary);
+		HLDSPrefetchingDumpReader<Key, Value> unread(in, 4096, 2);
+	}
+
+	// merges produce the same bytes with either reader
+	{
+		std::ifstream in1(paths.at(0), std::ios_base::binary), in2(paths.at(1), std::ios_base::binary);
+		std::stringstream expected;
+		HLDSBinaryDumpMerger<Key, Value>(in1, in2, expected).run();
+
+		std::ifstream prefetching1(paths.at(0), std::ios_base::binary), prefetching2(paths.at(1), std::ios_base::binary);
+		std::stringstream merged;
+		HLDSBinaryDumpMerger<Key, Value, SumReducer<Value>, HLDSPrefetchingDumpReader<Key, Value>>(prefetching1, prefetching2, merged).run();
+
+		assert(merged.str() == expected.str());
+	}
+
+	auto mergeAll = [&paths](const bool prefetch, std::ostream &dst){
+		std::vector<std::unique_ptr<std::ifstream>> inputs;
+		std::vector<std::istream *> sources;
+		for(const std::string &path : paths){
+			inputs.emplace_back(new std::ifstream(path, std::ios_base::binary));
+			sources.push_back(inputs.back().get());
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		if(prefetch){
+			HLDSDumpMerger<Key, SumReducer<Value>, HLDSPrefetchingDumpReader<Key, Value>>(sources, dst).run();
+		}
+		else{
+			HLDSDumpMerger<Key, SumReducer<Value>>(sources, dst).run();
+		}
+
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	std::stringstream expected, merged;
+	const double plainTime = mergeAll(false, expected);
+	const double prefetchingTime = mergeAll(true, merged);
+	assert(merged.str() == expected.str());
+
+	double megabytes = 0;
+	for(const std::string &path : paths){
+		megabytes += readFile(path).size() / 1048576.0;
+	}
+
+	report() << dumpCount << "-way merge of " << megabytes << " MiB: " << megabytes / plainTime << " -> " << megabytes / prefetchingTime << " MiB/s" << std::endl;
+
+	for(const std::string &path : paths){
+		std::remove(path.c_str());
+	}
+}
+
+
+int main(int argc, char **argv){
+	benchmarking = argc > 1 && std::string(argv[1]) == "--benchmark";
 
-int main(){
 	TTF_TEST(keyTest);
 	TTF_TEST(keyItem2bitsetTest);
 	TTF_TEST(RAMUsageTest);
@@ -432,6 +2351,32 @@ int main(){
 	TTF_TEST(dumperTest);
 	TTF_TEST(equalsTest);
 	TTF_TEST(mergeTest);
+	TTF_TEST(reducerMergeTest);
+	TTF_TEST(sampleMatrixMergeTest);
+	TTF_TEST(dumpSetOperationsTest);
+	TTF_TEST(externalCounterTest);
+	TTF_TEST(pagingTest);
+	TTF_TEST(frozenTest);
+	TTF_TEST(succinctTest);
+	TTF_TEST(minimalPerfectHashTest);
+	TTF_TEST(frozenImageTest);
+	TTF_TEST(checkpointTest);
+	TTF_TEST(indexedStorageTest);
+	TTF_TEST(twoBitStorageTest);
+	TTF_TEST(canonicalCounterTest);
+	TTF_TEST(minimizerBucketerTest);
+	TTF_TEST(filteredCounterTest);
+	TTF_TEST(layoutAdvisorTest);
+	TTF_TEST(fixedStorageTest);
+	TTF_TEST(narrowCounterTest);
+	TTF_TEST(pruneTest);
+	TTF_TEST(inMemoryMergeTest);
+	TTF_TEST(snapshotTest);
+	TTF_TEST(concurrentReadTest);
+	TTF_TEST(parallelScanTest);
+	TTF_TEST(parallelDumpTest);
+	TTF_TEST(bufferedDumpTest);
+	TTF_TEST(prefetchingReaderTest);
 }
 
 